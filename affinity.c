@@ -0,0 +1,272 @@
+/*
+ *	CPU affinity and NUMA placement of the solver threads
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include "affinity.h"
+
+//Pages asked about per move_pages() call
+#define PAGE_BATCH 1024
+
+typedef struct {
+	int cpu;
+	int node;
+	int package;
+	int core;
+	int smt;		//position among the hyperthreads of its core
+	int slot;		//position of its core among the cores of its node
+} CpuInfo;
+
+/*
+ * Read a single integer from a sysfs file
+ * Return: the value, fallback if the file is missing
+ */
+static int sysfsInt(int cpu, const char *name, int fallback)
+{
+	char path[128];
+	FILE *fp;
+	int value;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return fallback;
+	if (fscanf(fp, "%d", &value) != 1)
+		value = fallback;
+	fclose(fp);
+	return value;
+}
+
+/*
+ * NUMA node of a CPU, from the nodeK link in its sysfs directory
+ * Return: the node, 0 if the kernel does not say
+ */
+int cpuNode(int cpu)
+{
+	char path[64];
+	DIR *dir;
+	struct dirent *entry;
+	int node = 0;
+
+	if (cpu < 0)
+		return 0;
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (dir == NULL)
+		return 0;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strncmp(entry->d_name, "node", 4) == 0 &&
+				sscanf(entry->d_name + 4, "%d", &node) == 1)
+			break;
+	}
+	closedir(dir);
+	return node;
+}
+
+static int compareCompact(const void *a, const void *b)
+{
+	const CpuInfo *x = (const CpuInfo *) a;
+	const CpuInfo *y = (const CpuInfo *) b;
+
+	if (x->node != y->node)
+		return x->node - y->node;
+	if (x->package != y->package)
+		return x->package - y->package;
+	if (x->core != y->core)
+		return x->core - y->core;
+	return x->cpu - y->cpu;
+}
+
+static int compareScatter(const void *a, const void *b)
+{
+	const CpuInfo *x = (const CpuInfo *) a;
+	const CpuInfo *y = (const CpuInfo *) b;
+
+	if (x->smt != y->smt)
+		return x->smt - y->smt;
+	if (x->slot != y->slot)
+		return x->slot - y->slot;
+	if (x->node != y->node)
+		return x->node - y->node;
+	return x->cpu - y->cpu;
+}
+
+/*
+ * Topology of the CPUs in set
+ * Return: number of CPUs stored in info
+ */
+static int readTopology(const cpu_set_t *set, CpuInfo *info)
+{
+	int count = 0;
+	int cpu, a, b;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (!CPU_ISSET(cpu, set))
+			continue;
+		info[count].cpu = cpu;
+		info[count].node = cpuNode(cpu);
+		info[count].package = sysfsInt(cpu, "physical_package_id", 0);
+		info[count].core = sysfsInt(cpu, "core_id", cpu);
+		count++;
+	}
+
+	//Hyperthreads of a core are numbered in CPU order
+	for (a = 0; a < count; a++)
+	{
+		info[a].smt = 0;
+		for (b = 0; b < a; b++)
+			if (info[b].package == info[a].package && info[b].core == info[a].core)
+				info[a].smt++;
+	}
+	//Cores of a node are numbered in the order of their first hyperthread
+	for (a = 0; a < count; a++)
+	{
+		int lead = 0;
+		while (info[lead].package != info[a].package || info[lead].core != info[a].core)
+			lead++;
+		info[a].slot = 0;
+		for (b = 0; b < lead; b++)
+			if (info[b].node == info[a].node && info[b].smt == 0)
+				info[a].slot++;
+	}
+	return count;
+}
+
+/*
+ * Parse a CPU list such as "0,2,4-7" into cpus
+ * Return: number of CPUs, -1 if spec is malformed, names a CPU outside
+ *	allowed or is longer than max
+ */
+static int parseList(const char *spec, const cpu_set_t *allowed, int *cpus, int max)
+{
+	const char *p = spec;
+	int count = 0;
+
+	while (*p != '\0')
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		long last = first;
+		long cpu;
+
+		if (end == p || first < 0)
+			return -1;
+		if (*end == '-')
+		{
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				return -1;
+		}
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		p = end;
+		for (cpu = first; cpu <= last; cpu++)
+		{
+			if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, allowed) || count == max)
+				return -1;
+			cpus[count++] = (int) cpu;
+		}
+	}
+	return count;
+}
+
+/*
+ * CPU for each of threads workers under spec ("compact", "scatter" or a
+ * list), stored in cpus[0..threads-1]
+ * Return: 0 on success, -1 if spec is invalid or no CPU is usable
+ */
+int affinityCpus(const char *spec, int threads, int *cpus)
+{
+	cpu_set_t allowed;
+	int *order;
+	int count, k;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return -1;
+
+	if (strcmp(spec, "compact") == 0 || strcmp(spec, "scatter") == 0)
+	{
+		CpuInfo *info = malloc(CPU_SETSIZE * sizeof(CpuInfo));
+
+		if (info == NULL)
+			return -1;
+		count = readTopology(&allowed, info);
+		qsort(info, count, sizeof(CpuInfo),
+				(strcmp(spec, "compact") == 0) ? compareCompact : compareScatter);
+		order = malloc((count > 0 ? count : 1) * sizeof(int));
+		if (order == NULL)
+		{
+			free(info);
+			return -1;
+		}
+		for (k = 0; k < count; k++)
+			order[k] = info[k].cpu;
+		free(info);
+	}
+	else
+	{
+		order = malloc(CPU_SETSIZE * sizeof(int));
+		if (order == NULL)
+			return -1;
+		count = parseList(spec, &allowed, order, CPU_SETSIZE);
+	}
+
+	if (count <= 0)
+	{
+		free(order);
+		return -1;
+	}
+	for (k = 0; k < threads; k++)
+		cpus[k] = order[k % count];
+	free(order);
+	return 0;
+}
+
+/*
+ * Add the pages of addr..addr+bytes to count: local if they are on node,
+ * remote if on another node, absent if never touched
+ * Return: 0, -1 if the kernel cannot tell (no NUMA support)
+ */
+int pageNodes(const void *addr, size_t bytes, int node, PageCount *count)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long first = (unsigned long) addr / pageSize;
+	unsigned long last = ((unsigned long) addr + bytes - 1) / pageSize;
+	void *pages[PAGE_BATCH];
+	int status[PAGE_BATCH];
+	unsigned long page;
+
+	if (bytes == 0)
+		return 0;
+	for (page = first; page <= last; )
+	{
+		int n = 0;
+		int k;
+
+		while (n < PAGE_BATCH && page <= last)
+			pages[n++] = (void *) (page++ * pageSize);
+		if (syscall(SYS_move_pages, 0, (unsigned long) n, pages, NULL, status, 0) != 0)
+			return -1;
+		for (k = 0; k < n; k++)
+		{
+			if (status[k] < 0)
+				count->absent++;
+			else if (status[k] == node)
+				count->local++;
+			else
+				count->remote++;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ *	CPU affinity and NUMA placement of the solver threads
+ *
+ *	On a machine with several NUMA nodes a page is placed on the node of the
+ *	thread that first writes it and stays there. The threaded program lets
+ *	every worker initialize the part of the plate it sweeps, and can pin the
+ *	workers to CPUs so that they stay next to that memory:
+ *
+ *	compact - fill a node, and the hyperthreads of a core, before moving on
+ *		to the next one: threads that share halo rows share caches too
+ *	scatter - spread the threads over the nodes first, then over the cores,
+ *		and only then onto hyperthreads: the most memory bandwidth
+ *	LIST - explicit CPUs such as "0,2,4-7"; thread k gets the k-th CPU of
+ *		the list, which is repeated when there are more threads
+ *
+ *	Only CPUs the process is allowed to run on are used. The topology is
+ *	read from /sys/devices/system/cpu; CPUs without it count as separate
+ *	cores of node 0.
+ */
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stddef.h>
+
+typedef struct {
+	long local;		//pages on the node of the thread's CPU
+	long remote;	//pages on another node
+	long absent;	//pages not touched yet
+} PageCount;
+
+int affinityCpus(const char *spec, int threads, int *cpus);
+int cpuNode(int cpu);
+int pageNodes(const void *addr, size_t bytes, int node, PageCount *count);
+
+#endif
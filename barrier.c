@@ -5,6 +5,17 @@
  */
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <sched.h>
+#endif
+#include "barrier.h"
+
 //Barrier method
 void barrier(pthread_mutex_t *mutex, pthread_cond_t *cond, int* counter, int total, int rank)
 {
@@ -27,3 +38,129 @@ void barrier(pthread_mutex_t *mutex, pthread_cond_t *cond, int* counter, int tot
 	pthread_mutex_unlock(mutex);
 
 }
+
+/******************************************************************************/
+/* Sense-reversing barrier */
+/******************************************************************************/
+
+//Polls of the sense before a waiting thread goes to sleep
+#define BARRIER_SPIN 2000
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpuRelax() __builtin_ia32_pause()
+#else
+#define cpuRelax() do { } while (0)
+#endif
+
+static unsigned long long doubleBits(double d)
+{
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+static double bitsDouble(unsigned long long bits)
+{
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static void futexWait(int *addr, int expected)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+	(void) addr; (void) expected;
+	sched_yield();
+#endif
+}
+
+static void futexWakeAll(int *addr)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 0x7fffffff, NULL, NULL, 0);
+#else
+	(void) addr;
+#endif
+}
+
+void barrierInit(Barrier *b, int total)
+{
+	memset(b, 0, sizeof(*b));
+	b->total = total;
+	b->spin = BARRIER_SPIN;
+#ifdef _SC_NPROCESSORS_ONLN
+	if (total > sysconf(_SC_NPROCESSORS_ONLN))
+		b->spin = 0;
+#endif
+	b->value[0] = doubleBits(-INFINITY);
+	b->value[1] = doubleBits(-INFINITY);
+}
+
+/*
+ * One barrier episode. If value is not NULL it is folded into the
+ * episode's reduction slot before arriving.
+ * Return: the slot used by this episode
+ */
+static int barrierEpisode(Barrier *b, int *localSense, const double *value)
+{
+	int sense = !*localSense;	//value the shared sense takes when we are released
+	int spin;
+	*localSense = sense;
+
+	if (value != NULL)
+	{
+		//Atomic max on the slot of this episode
+		unsigned long long *slot = &b->value[sense];
+		unsigned long long old = __atomic_load_n(slot, __ATOMIC_RELAXED);
+		while (bitsDouble(old) < *value &&
+				!__atomic_compare_exchange_n(slot, &old, doubleBits(*value), 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+	}
+
+	if (__atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == b->total)
+	{
+		//Last one in: reset for the next episode (which uses the other slot),
+		//then release everyone
+		b->count = 0;
+		b->value[!sense] = doubleBits(-INFINITY);
+		__atomic_store_n(&b->sense, sense, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&b->sleepers, __ATOMIC_SEQ_CST) > 0)
+			futexWakeAll(&b->sense);
+		return sense;
+	}
+
+	for (spin = 0; spin < b->spin; spin++)
+	{
+		if (__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) == sense)
+			return sense;
+		cpuRelax();
+	}
+
+	//Still not released: sleep until the sense flips
+	__atomic_add_fetch(&b->sleepers, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&b->sense, __ATOMIC_SEQ_CST) != sense)
+		futexWait(&b->sense, !sense);
+	__atomic_sub_fetch(&b->sleepers, 1, __ATOMIC_RELAXED);
+	return sense;
+}
+
+/*
+ * Wait until all b->total threads have arrived
+ */
+void barrierWait(Barrier *b, int *localSense)
+{
+	barrierEpisode(b, localSense, NULL);
+}
+
+/*
+ * Wait until all b->total threads have arrived, then return the largest
+ * value passed in by any of them during this episode
+ */
+double barrierReduceMax(Barrier *b, int *localSense, double value)
+{
+	int slot = barrierEpisode(b, localSense, &value);
+	return bitsDouble(__atomic_load_n(&b->value[slot], __ATOMIC_RELAXED));
+}
@@ -3,4 +3,39 @@
  *	Author: Huan Nguyen
  *	email: hpn007@ucsd.edu
  */
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <pthread.h>
+
 void barrier(pthread_mutex_t *mutex, pthread_cond_t *cond, int* counter, int total, int rank);
+
+/*
+ *	Sense-reversing barrier with a built-in max reduction
+ *
+ *	Threads spin on the shared sense for a while and then sleep on it with a
+ *	futex, so a short wait costs no system call and a long one burns no CPU.
+ *	When there are more threads than CPUs the spinning is skipped, since the
+ *	thread everyone is waiting for may need the CPU the spinner holds.
+ *	Every thread keeps its own local sense (an int set to 0 before the first
+ *	episode) and passes it in on each call.
+ */
+#define BARRIER_LINE 64
+
+typedef struct {
+	int total;
+	int spin;							//polls of the sense before sleeping
+	char pad0[BARRIER_LINE - 2 * sizeof(int)];
+	int count;							//threads arrived in the current episode
+	char pad1[BARRIER_LINE - sizeof(int)];
+	int sense;							//flipped by the last thread to arrive
+	int sleepers;						//threads blocked in the futex
+	char pad2[BARRIER_LINE - 2 * sizeof(int)];
+	unsigned long long value[2];		//max-reduction slot of each sense, as bits
+} Barrier;
+
+void barrierInit(Barrier *b, int total);
+void barrierWait(Barrier *b, int *localSense);
+double barrierReduceMax(Barrier *b, int *localSense, double value);
+
+#endif
@@ -2,33 +2,60 @@
  *	Tester for barrier
  *	Author: Huan Nguyen
  *	email: hpn007@ucsd.edu
+ *
+ *	Usage: barrier T I
+ *	Runs I episodes of each barrier with T threads and reports the average
+ *	cost of one episode:
+ *		condvar - barrier(), mutex + condition variable
+ *		sense   - barrierWait(), sense-reversing spin-then-futex
+ *		reduce  - barrierReduceMax(), sense-reversing with a max reduction
+ *	The reduce run also checks that every thread got the right maximum.
  */
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include "barrier.h"
 
+#define CONDVAR 0
+#define SENSE 1
+#define REDUCE 2
+
 void *thread_work (void* rank);
 
 pthread_mutex_t mutex;
 pthread_cond_t cond;
 int counter;
+Barrier bar;
 int t_count;
 int i_count;
+int kind;
+int errors;
 
-int main (int argc, char* argv[])
+double wall_time ( void )
 {
-	if (argc < 3)
-		exit(-1);
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-	t_count = atoi(argv[1]);
-	i_count = atoi(argv[2]);
-	counter = 0;
-	
-	//Allcocate thread's handles
+/*
+ * Run i_count episodes of one barrier kind on t_count threads
+ * Return: nanoseconds per episode
+ */
+double run(int which)
+{
 	pthread_t* handles = malloc (t_count * sizeof(pthread_t));
+	long thread;
+	double start;
+
+	kind = which;
+	counter = 0;
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	barrierInit(&bar, t_count);
 
-	int thread = 0;
+	start = wall_time();
 	//Spin up T threads
 	for (thread = 0; thread < t_count; thread++)
 		pthread_create(&handles[thread], NULL, thread_work,  (void *) thread);
@@ -36,16 +63,53 @@ int main (int argc, char* argv[])
 	//Join threads
 	for (thread = 0; thread < t_count; thread++)
 		pthread_join(handles[thread], NULL);
+
+	free(handles);
+	return (wall_time() - start) * 1e9 / i_count;
+}
+
+int main (int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: barrier threads episodes\n");
+		exit(-1);
+	}
+
+	t_count = atoi(argv[1]);
+	i_count = atoi(argv[2]);
+	if (t_count < 1 || i_count < 1)
+		exit(-1);
+
+	printf("%d threads, %d episodes\n", t_count, i_count);
+	printf("  condvar  %10.1f ns/episode\n", run(CONDVAR));
+	printf("  sense    %10.1f ns/episode\n", run(SENSE));
+	printf("  reduce   %10.1f ns/episode\n", run(REDUCE));
+	if (errors)
+		printf("  reduce returned a wrong maximum %d times\n", errors);
+	return errors != 0;
 }
 
 void *thread_work (void* rank)
 {
-	int my_rank = (int) rank;
+	int my_rank = (int) (long) rank;
+	int sense = 0;
 	
 	int i = 0;
 	for (i = 0; i < i_count; i++)
 	{
 		//printf("(%d)\tThread #%d is entering barrier...\n", i, my_rank);
-		barrier(&mutex, &cond, &counter, t_count);
+		if (kind == CONDVAR)
+			barrier(&mutex, &cond, &counter, t_count, my_rank);
+		else if (kind == SENSE)
+			barrierWait(&bar, &sense);
+		else
+		{
+			//The thread holding the max changes every episode
+			double value = (my_rank == i % t_count) ? i : -1.0;
+			if (barrierReduceMax(&bar, &sense, value) != i)
+				__atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+		}
 	}
+	return NULL;
 }
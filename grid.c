@@ -0,0 +1,694 @@
+/*
+ *	Contiguous storage for the temperature grid
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "grid.h"
+
+#define DOUBLES_PER_LINE (GRID_ALIGN / (int) sizeof(double))
+#define FLOATS_PER_LINE (GRID_ALIGN / (int) sizeof(float))
+
+//Fails to compile if the header layout no longer matches GRID_HEADER_SIZE
+typedef char gridHeaderSizeCheck[(sizeof(GridHeader) == GRID_HEADER_SIZE) ? 1 : -1];
+
+/*
+ * Row pitch (in doubles) used for a grid with N columns
+ */
+int gridStride(int N)
+{
+	int stride = (N + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+
+	//Avoid a pitch that is a multiple of 4KB: shift each row by one line
+	if ((stride * sizeof(double)) % 4096 == 0)
+		stride += DOUBLES_PER_LINE;
+	return stride;
+}
+
+/*
+ * Allocate an M x N grid as a single aligned block
+ * Return: 0 on success, -1 if the allocation failed
+ */
+int gridAlloc(Grid *g, int M, int N)
+{
+	void *data;
+
+	g->M = M;
+	g->N = N;
+	g->stride = gridStride(N);
+	if (posix_memalign(&data, GRID_ALIGN, (size_t) M * g->stride * sizeof(double)) != 0)
+	{
+		g->data = NULL;
+		return -1;
+	}
+	g->data = (double *) data;
+	return 0;
+}
+
+void gridFree(Grid *g)
+{
+	free(g->data);
+	g->data = NULL;
+}
+
+/*
+ * Allocate an aligned scratch row of N doubles (free with free())
+ */
+double *rowAlloc(int N)
+{
+	void *row;
+	if (posix_memalign(&row, GRID_ALIGN, (size_t) gridStride(N) * sizeof(double)) != 0)
+		return NULL;
+	return (double *) row;
+}
+
+/*
+ * Row pitch (in floats) used for a single precision grid with N columns
+ */
+int gridStrideF(int N)
+{
+	int stride = (N + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE * FLOATS_PER_LINE;
+
+	if ((stride * sizeof(float)) % 4096 == 0)
+		stride += FLOATS_PER_LINE;
+	return stride;
+}
+
+/*
+ * Allocate an M x N single precision grid
+ * Return: 0 on success, -1 if the allocation failed
+ */
+int gridAllocF(GridF *g, int M, int N)
+{
+	void *data;
+
+	g->M = M;
+	g->N = N;
+	g->stride = gridStrideF(N);
+	if (posix_memalign(&data, GRID_ALIGN, (size_t) M * g->stride * sizeof(float)) != 0)
+	{
+		g->data = NULL;
+		return -1;
+	}
+	g->data = (float *) data;
+	return 0;
+}
+
+void gridFreeF(GridF *g)
+{
+	free(g->data);
+	g->data = NULL;
+}
+
+/*
+ * Allocate an aligned scratch row of N floats (free with free())
+ */
+float *rowAllocF(int N)
+{
+	void *row;
+	if (posix_memalign(&row, GRID_ALIGN, (size_t) gridStrideF(N) * sizeof(float)) != 0)
+		return NULL;
+	return (float *) row;
+}
+
+/*
+ * Round rows first..last of src to single precision into dst
+ */
+void gridToFloat(GridF *dst, const Grid *src, int first, int last)
+{
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		const double *in = GRID_ROW(src, i);
+		float *out = GRIDF_ROW(dst, i);
+		for (j = 0; j < src->N; j++)
+			out[j] = (float) in[j];
+	}
+}
+
+/*
+ * Widen the interior points of rows first..last of src back into dst. The
+ * boundary of dst is left alone: its float copy is rounded, and the double
+ * sweeps and the solution file need the exact edge temperatures.
+ */
+void gridToDouble(Grid *dst, const GridF *src, int first, int last)
+{
+	int i, j;
+
+	if (first < 1)
+		first = 1;
+	if (last > src->M - 2)
+		last = src->M - 2;
+	for (i = first; i <= last; i++)
+	{
+		const float *in = GRIDF_ROW(src, i);
+		double *out = GRID_ROW(dst, i);
+		for (j = 1; j < src->N - 1; j++)
+			out[j] = in[j];
+	}
+}
+
+/******************************************************************************/
+/* Initialize the plate with boundary and mean temperature */
+/******************************************************************************/
+void initialize_plate(Grid *u, double Tl, double Tr, double Tt, double Tb)
+{
+	double mean = plateMean(u, Tl, Tr, Tt, Tb);
+
+	plateFill(u, 0, u->M, 0, u->N, Tl, Tr, Tt, Tb, mean);
+	return;
+}
+
+/*
+ * Average of the boundary values, a reasonable initial value for the
+ * interior. The values are added in the same order whoever fills the plate,
+ * so the result is always the same.
+ */
+double plateMean(const Grid *u, double Tl, double Tr, double Tt, double Tb)
+{
+	int M = u->M;
+	int N = u->N;
+	int i, j;
+	double mean = 0.0;
+
+	for ( i = 1; i < M - 1; i++ )
+	{
+		mean += Tl;
+		mean += Tr;
+	}
+	for ( j = 0; j < N; j++ )
+	{
+		mean += Tt;
+		mean += Tb;
+	}
+	return mean / ( double ) ( 2 * M + 2 * N - 4 );
+}
+
+/*
+ * Initialize the points i0..i1-1 x j0..j1-1 of the plate: boundary
+ * temperatures on the edges, mean in the interior. Writing a block is also
+ * the first touch of its pages, so the thread that fills it places it on
+ * its own NUMA node.
+ */
+void plateFill(Grid *u, int i0, int i1, int j0, int j1,
+		double Tl, double Tr, double Tt, double Tb, double mean)
+{
+	int M = u->M;
+	int N = u->N;
+	int i, j;
+
+	for ( i = i0; i < i1; i++ )
+	{
+		double *row = GRID_ROW(u, i);
+
+		if (i == M - 1 || i == 0)
+		{
+			double T = (i == M - 1) ? Tb : Tt;
+			for ( j = j0; j < j1; j++ )
+				row[j] = T;
+			continue;
+		}
+		for ( j = j0; j < j1; j++ )
+			row[j] = mean;
+		if (j0 == 0 && j1 > 0)
+			row[0] = Tl;
+		if (j0 <= N - 1 && j1 >= N)
+			row[N-1] = Tr;
+	}
+}
+
+/*
+ * Set the edges of the plate to the boundary temperatures as plateFill()
+ * does, leaving the interior as it is
+ */
+void plateEdges(Grid *u, double Tl, double Tr, double Tt, double Tb)
+{
+	int M = u->M;
+	int N = u->N;
+	int i, j;
+
+	if (M < 1)
+		return;
+	for ( j = 0; j < N; j++ )
+	{
+		GRID_ROW(u, 0)[j] = Tt;
+		GRID_ROW(u, M - 1)[j] = Tb;
+	}
+	for ( i = 1; i < M - 1; i++ )
+	{
+		GRID_ROW(u, i)[0] = Tl;
+		GRID_ROW(u, i)[N - 1] = Tr;
+	}
+}
+
+/*
+ * One value as "%15.7f " without going through printf: the value is scaled
+ * to an integer number of 1e-7 units and printed digit by digit.
+ * Return: 0, or -1 if the value does not fit in 15 characters, is not
+ * finite, or is so close to halfway between two outputs that the rounded
+ * product can't tell which one printf would pick; the caller formats those
+ * with snprintf.
+ */
+static int formatValue(char *out, double v)
+{
+	char digits[24];
+	double a = fabs(v);
+	double scaled, frac;
+	unsigned long long q;
+	int n = 0, len, k = 0;
+
+	if (!(a < 1e7))
+		return -1;
+	scaled = a * 1e7;
+	q = (unsigned long long) scaled;
+	frac = scaled - (double) q;
+	//The product is within scaled * 2^-53 of the exact value
+	if (fabs(frac - 0.5) <= scaled * 2.3e-16)
+		return -1;
+	if (frac > 0.5)
+		q++;
+	do
+	{
+		digits[n++] = (char) ('0' + q % 10);
+		q /= 10;
+	} while (q > 0 || n < 8);
+	len = n + 1 + (signbit(v) ? 1 : 0);
+	if (len > GRID_TEXT_VALUE - 1)
+		return -1;
+	while (k < GRID_TEXT_VALUE - 1 - len)
+		out[k++] = ' ';
+	if (signbit(v))
+		out[k++] = '-';
+	while (n > 7)
+		out[k++] = digits[--n];
+	out[k++] = '.';
+	while (n > 0)
+		out[k++] = digits[--n];
+	out[k] = ' ';
+	return 0;
+}
+
+/*
+ * Format one row of the text format into out (GRID_TEXT_ROW(N) bytes)
+ * Return: 0, or -1 if a value needs more than 15 characters (out is then
+ * incomplete and the row has to be written with fprintf)
+ */
+int gridFormatRow(char *out, const double *row, int N)
+{
+	char tmp[GRID_TEXT_VALUE + 1];
+	int j;
+
+	for (j = 0; j < N; j++, out += GRID_TEXT_VALUE)
+	{
+		if (formatValue(out, row[j]) == 0)
+			continue;
+		if (snprintf(tmp, sizeof(tmp), "%15.7f ", row[j]) != GRID_TEXT_VALUE)
+			return -1;
+		memcpy(out, tmp, GRID_TEXT_VALUE);
+	}
+	*out = '\n';
+	return 0;
+}
+
+/*
+ * The "M\nN\n" header of the text format
+ * Return: its length
+ */
+int gridTextHeader(char *out, size_t size, const Grid *u)
+{
+	return snprintf(out, size, "%d\n%d\n", u->M, u->N);
+}
+
+/*
+ * Write the grid in the text format read by heatmap.py
+ */
+void gridWriteText(FILE *fp, const Grid *u)
+{
+	fprintf ( fp, "%d\n", u->M );
+	fprintf ( fp, "%d\n", u->N );
+	gridWriteTextBody(fp, u);
+}
+
+/*
+ * The rows of the text format, without the M and N lines
+ */
+void gridWriteTextBody(FILE *fp, const Grid *u)
+{
+	char *buf = malloc(GRID_TEXT_ROW(u->N));
+	int i, j;
+
+	for ( i = 0; i < u->M; i++ )
+	{
+		const double *row = GRID_ROW(u, i);
+		if (buf != NULL && gridFormatRow(buf, row, u->N) == 0)
+		{
+			fwrite(buf, 1, GRID_TEXT_ROW(u->N), fp);
+			continue;
+		}
+		for ( j = 0; j < u->N; j++)
+		{
+			fprintf ( fp, "%15.7f ", row[j] );
+		}
+		fputc ( '\n', fp);
+	}
+	free(buf);
+}
+
+/*
+ * pwrite() all of buf at offset at
+ * Return: 0 on success, -1 on a write error
+ */
+int gridWriteAt(int fd, const void *buf, size_t size, off_t at)
+{
+	size_t done = 0;
+	while (done < size)
+	{
+		ssize_t n = pwrite(fd, (const char *) buf + done, size - done, at + done);
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+	return 0;
+}
+
+/*
+ * Format rows first..last of the text format and pwrite() them to fd,
+ * where row i goes to offset + i * GRID_TEXT_ROW(N). Rows are formatted
+ * into a private buffer of up to about 1MB and written a buffer at a time.
+ * Return: 0 on success, -1 on a write error or a value wider than 15
+ * characters (the file then has to be written with gridWriteText)
+ */
+int gridWriteTextRows(int fd, const Grid *u, int first, int last, size_t offset)
+{
+	size_t rowSize = GRID_TEXT_ROW(u->N);
+	int batch = (int) ((1 << 20) / rowSize);
+	char *buf;
+	int i, k;
+
+	if (batch < 1)
+		batch = 1;
+	buf = malloc(batch * rowSize);
+	if (buf == NULL)
+		return -1;
+	for (i = first; i <= last; i += batch)
+	{
+		int rows = (last - i + 1 < batch) ? last - i + 1 : batch;
+		size_t size = rows * rowSize;
+		off_t at = (off_t) (offset + (size_t) i * rowSize);
+
+		for (k = 0; k < rows; k++)
+		{
+			if (gridFormatRow(buf + k * rowSize, GRID_ROW(u, i + k), u->N) != 0)
+			{
+				free(buf);
+				return -1;
+			}
+		}
+		if (gridWriteAt(fd, buf, size, at) != 0)
+		{
+			free(buf);
+			return -1;
+		}
+	}
+	free(buf);
+	return 0;
+}
+
+/*
+ * Header of the binary format for u
+ */
+static void gridHeader(GridHeader *h, const Grid *u, const GridInfo *info)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, GRID_MAGIC, sizeof(h->magic));
+	h->version = GRID_VERSION;
+	h->headerSize = GRID_HEADER_SIZE;
+	h->dtype = GRID_DTYPE_F64;
+	h->M = u->M;
+	h->N = u->N;
+	h->iterations = info->iterations;
+	h->Tl = info->Tl;
+	h->Tr = info->Tr;
+	h->Tt = info->Tt;
+	h->Tb = info->Tb;
+	h->tol = info->tol;
+}
+
+/*
+ * pwrite() the header of the binary format for the M x N plate u (only its
+ * size is used) to the start of fd
+ * Return: 0 on success, -1 on a write error
+ */
+int gridWriteHeader(int fd, const Grid *u, const GridInfo *info)
+{
+	GridHeader h;
+
+	gridHeader(&h, u, info);
+	return gridWriteAt(fd, &h, sizeof(h), 0);
+}
+
+/*
+ * pwrite() rows first..last of u in the binary format, where row i goes to
+ * offset + i * N * sizeof(double)
+ * Return: 0 on success, -1 on a write error
+ */
+int gridWriteBinaryRows(int fd, const Grid *u, int first, int last, size_t offset)
+{
+	size_t rowSize = (size_t) u->N * sizeof(double);
+	int i;
+
+	for (i = first; i <= last; i++)
+	{
+		if (gridWriteAt(fd, GRID_ROW(u, i), rowSize, (off_t) (offset + (size_t) i * rowSize)) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Write the grid in the binary format (header, then the rows)
+ * Return: 0 on success, -1 on a write error
+ */
+int gridWriteBinary(FILE *fp, const Grid *u, const GridInfo *info)
+{
+	GridHeader h;
+	int i;
+
+	gridHeader(&h, u, info);
+	if (fwrite(&h, sizeof(h), 1, fp) != 1)
+		return -1;
+	for (i = 0; i < u->M; i++)
+	{
+		if (fwrite(GRID_ROW(u, i), sizeof(double), u->N, fp) != (size_t) u->N)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Write the binary format so that a crash at any point leaves either the
+ * complete file or one that gridReadHeader() rejects: the header is
+ * written zeroed, then the values, and only once they are on disk the
+ * real header (with the magic) goes over it.
+ * Return: 0 on success, -1 on a write error
+ */
+int gridWriteCheckpoint(const char *path, const Grid *u, const GridInfo *info)
+{
+	GridHeader h;
+	size_t rowSize = (size_t) u->N * sizeof(double);
+	int fd = open(path, O_WRONLY | O_CREAT, 0644);
+	int status = 0;
+	int i;
+
+	if (fd < 0)
+		return -1;
+	memset(&h, 0, sizeof(h));
+	if (gridWriteAt(fd, &h, sizeof(h), 0) != 0 || fsync(fd) != 0)
+		status = -1;
+	for (i = 0; i < u->M && status == 0; i++)
+		status = gridWriteAt(fd, GRID_ROW(u, i), rowSize, GRID_HEADER_SIZE + (off_t) i * rowSize);
+	if (status == 0 && (ftruncate(fd, GRID_HEADER_SIZE + (off_t) u->M * rowSize) != 0 ||
+				fsync(fd) != 0))
+		status = -1;
+	gridHeader(&h, u, info);
+	if (status == 0 && (gridWriteAt(fd, &h, sizeof(h), 0) != 0 || fsync(fd) != 0))
+		status = -1;
+	if (close(fd) != 0)
+		status = -1;
+	return status;
+}
+
+/*
+ * Read and check the header of a binary file
+ * Return: 0 if path is a complete binary file this program can read, -1
+ * otherwise
+ */
+int gridReadHeader(const char *path, GridHeader *h)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	int status = -1;
+
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) == 0 && pread(fd, h, sizeof(*h), 0) == (ssize_t) sizeof(*h) &&
+			memcmp(h->magic, GRID_MAGIC, sizeof(h->magic)) == 0 &&
+			h->version == GRID_VERSION && h->dtype == GRID_DTYPE_F64 &&
+			h->M > 0 && h->N > 0 && st.st_size >= (off_t) h->headerSize +
+			(off_t) h->M * h->N * (off_t) sizeof(double))
+		status = 0;
+	close(fd);
+	return status;
+}
+
+/*
+ * Load a binary file into u, which must already have the file's size.
+ * The file is memory mapped and its rows copied into place.
+ * Return: 0 on success, -1 if the file can't be read or its size differs
+ */
+int gridReadBinary(const char *path, Grid *u, GridInfo *info)
+{
+	GridHeader h;
+	size_t size;
+	void *map;
+	int fd, i;
+
+	if (gridReadHeader(path, &h) != 0 || h.M != u->M || h.N != u->N)
+		return -1;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	size = h.headerSize + (size_t) h.M * h.N * sizeof(double);
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	for (i = 0; i < u->M; i++)
+		memcpy(GRID_ROW(u, i), (const char *) map + h.headerSize +
+				(size_t) i * u->N * sizeof(double), u->N * sizeof(double));
+	munmap(map, size);
+	info->Tl = h.Tl;
+	info->Tr = h.Tr;
+	info->Tt = h.Tt;
+	info->Tb = h.Tb;
+	info->iterations = h.iterations;
+	info->tol = h.tol;
+	return 0;
+}
+
+/*
+ * Write the solution file in format (GRID_FORMAT_BINARY, GRID_FORMAT_TEXT or
+ * GRID_FORMAT_CHECKPOINT)
+ * Return: 0 on success, -1 if the file could not be written
+ */
+int gridWriteFile(const char *path, const Grid *u, const GridInfo *info, int format)
+{
+	FILE *fp;
+	int status = 0;
+
+	if (format == GRID_FORMAT_CHECKPOINT)
+		return gridWriteCheckpoint(path, u, info);
+	fp = fopen(path, (format == GRID_FORMAT_TEXT) ? "w" : "wb");
+	if (fp == NULL)
+		return -1;
+	if (format == GRID_FORMAT_TEXT)
+		gridWriteText(fp, u);
+	else
+		status = gridWriteBinary(fp, u, info);
+	if (ferror(fp))
+		status = -1;
+	if (fclose(fp) != 0)
+		status = -1;
+	return status;
+}
+
+/*
+ * Load a solution file of either format into g, which is allocated with
+ * the file's size (free it with gridFree)
+ * Return: 0 on success, -1 if the file can't be read
+ */
+int gridLoad(const char *path, Grid *g)
+{
+	GridHeader h;
+	GridInfo info;
+	FILE *fp;
+	int M, N, i, j;
+
+	if (gridReadHeader(path, &h) == 0)
+	{
+		if (gridAlloc(g, h.M, h.N) != 0)
+			return -1;
+		if (gridReadBinary(path, g, &info) != 0)
+		{
+			gridFree(g);
+			return -1;
+		}
+		return 0;
+	}
+
+	//Text format: M, N, then the rows
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	if (fscanf(fp, "%d %d", &M, &N) != 2 || M < 1 || N < 1 || gridAlloc(g, M, N) != 0)
+	{
+		fclose(fp);
+		return -1;
+	}
+	for (i = 0; i < M; i++)
+	{
+		double *row = GRID_ROW(g, i);
+		for (j = 0; j < N; j++)
+		{
+			if (fscanf(fp, "%lf", &row[j]) != 1)
+			{
+				fclose(fp);
+				gridFree(g);
+				return -1;
+			}
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+/*
+ * Fill dst by bilinear interpolation of src, both covering the same plate
+ * (corner points coincide) at any resolution. With interior set only the
+ * interior points of dst are written and its boundary is kept.
+ */
+void gridResample(Grid *dst, const Grid *src, int interior)
+{
+	int i0 = interior ? 1 : 0;
+	int i1 = interior ? dst->M - 1 : dst->M;
+	int j0 = interior ? 1 : 0;
+	int j1 = interior ? dst->N - 1 : dst->N;
+	int i, j;
+
+	for (i = i0; i < i1; i++)
+	{
+		double x = (dst->M > 1) ? (double) i * (src->M - 1) / (dst->M - 1) : 0.0;
+		int k = (int) x;
+		int k1 = (k + 1 < src->M) ? k + 1 : k;
+		double a = x - k;
+		const double *s0 = GRID_ROW(src, k);
+		const double *s1 = GRID_ROW(src, k1);
+		double *row = GRID_ROW(dst, i);
+
+		for (j = j0; j < j1; j++)
+		{
+			double y = (dst->N > 1) ? (double) j * (src->N - 1) / (dst->N - 1) : 0.0;
+			int l = (int) y;
+			int l1 = (l + 1 < src->N) ? l + 1 : l;
+			double b = y - l;
+			row[j] = (1 - a) * ((1 - b) * s0[l] + b * s0[l1]) +
+				a * ((1 - b) * s1[l] + b * s1[l1]);
+		}
+	}
+}
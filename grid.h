@@ -0,0 +1,121 @@
+/*
+ *	Contiguous storage for the temperature grid
+ *
+ *	The plate is kept in one aligned block instead of one malloc per row.
+ *	Rows are padded to a whole number of cache lines so every row starts on
+ *	a GRID_ALIGN boundary, and the pitch is bumped by one extra line when it
+ *	would otherwise be a multiple of 4KB (power-of-two widths), so the rows
+ *	of a column don't all land in the same cache sets.
+ */
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define GRID_ALIGN 64
+
+typedef struct {
+	int M;			//number of rows
+	int N;			//number of columns
+	int stride;		//doubles from the start of one row to the next (>= N)
+	double *data;	//M * stride doubles, GRID_ALIGN aligned
+} Grid;
+
+/* Pointer to the first element of row i */
+#define GRID_ROW(g, i) ((g)->data + (size_t)(i) * (size_t)(g)->stride)
+
+int gridStride(int N);
+int gridAlloc(Grid *g, int M, int N);
+void gridFree(Grid *g);
+double *rowAlloc(int N);
+
+/*
+ *	Single precision copy of the plate (--precision=float|mixed), with the
+ *	same layout rules: half the bytes per row, twice the points per line.
+ */
+typedef struct {
+	int M;
+	int N;
+	int stride;		//floats from the start of one row to the next (>= N)
+	float *data;
+} GridF;
+
+#define GRIDF_ROW(g, i) ((g)->data + (size_t)(i) * (size_t)(g)->stride)
+
+int gridStrideF(int N);
+int gridAllocF(GridF *g, int M, int N);
+void gridFreeF(GridF *g);
+float *rowAllocF(int N);
+void gridToFloat(GridF *dst, const Grid *src, int first, int last);
+void gridToDouble(Grid *dst, const GridF *src, int first, int last);
+
+/*
+ *	Solution files
+ *
+ *	The binary format is a GridHeader followed by the M x N values, row
+ *	by row without padding, in the byte order of the machine that wrote it
+ *	(little-endian on x86). The header is GRID_HEADER_SIZE bytes, so the
+ *	values start on a cache line and the file can be memory mapped as an
+ *	array as it is (see heatmap.py). The text format is the original one:
+ *	M and N on a line each, then one line of "%15.7f " values per row.
+ *	As long as every value fits in those 15 characters each row is
+ *	GRID_TEXT_ROW(N) bytes, so row i starts at a known offset and rows can
+ *	be formatted and written independently (gridWriteTextRows).
+ */
+#define GRID_FORMAT_BINARY 0
+#define GRID_FORMAT_TEXT 1
+#define GRID_FORMAT_CHECKPOINT 2	//binary, made durable (gridWriteCheckpoint)
+
+#define GRID_MAGIC "HEAT2DB"	//8 bytes with the terminating 0
+#define GRID_VERSION 1
+#define GRID_HEADER_SIZE 128
+#define GRID_DTYPE_F64 1		//IEEE double
+
+#define GRID_TEXT_VALUE 16						//"%15.7f "
+#define GRID_TEXT_ROW(N) ((size_t) (N) * GRID_TEXT_VALUE + 1)	//with the newline
+
+typedef struct {
+	char magic[8];			//GRID_MAGIC
+	uint32_t version;		//GRID_VERSION
+	uint32_t headerSize;	//offset of the first value, GRID_HEADER_SIZE
+	uint32_t dtype;			//GRID_DTYPE_F64
+	int32_t M, N;			//rows, columns
+	int32_t iterations;		//iterations (or cycles) the solver ran
+	double Tl, Tr, Tt, Tb;	//boundary temperatures
+	double tol;				//final convergence measure
+	char reserved[GRID_HEADER_SIZE - 72];
+} GridHeader;
+
+/* What the solution file records besides the values */
+typedef struct {
+	double Tl, Tr, Tt, Tb;
+	int iterations;
+	double tol;
+} GridInfo;
+
+void initialize_plate(Grid *u, double Tl, double Tr, double Tt, double Tb);
+double plateMean(const Grid *u, double Tl, double Tr, double Tt, double Tb);
+void plateFill(Grid *u, int i0, int i1, int j0, int j1,
+		double Tl, double Tr, double Tt, double Tb, double mean);
+void plateEdges(Grid *u, double Tl, double Tr, double Tt, double Tb);
+void gridWriteText(FILE *fp, const Grid *u);
+void gridWriteTextBody(FILE *fp, const Grid *u);
+int gridWriteBinary(FILE *fp, const Grid *u, const GridInfo *info);
+int gridWriteFile(const char *path, const Grid *u, const GridInfo *info, int format);
+int gridWriteCheckpoint(const char *path, const Grid *u, const GridInfo *info);
+int gridReadHeader(const char *path, GridHeader *h);
+int gridReadBinary(const char *path, Grid *u, GridInfo *info);
+int gridLoad(const char *path, Grid *g);
+void gridResample(Grid *dst, const Grid *src, int interior);
+
+int gridFormatRow(char *out, const double *row, int N);
+int gridTextHeader(char *out, size_t size, const Grid *u);
+int gridWriteTextRows(int fd, const Grid *u, int first, int last, size_t offset);
+int gridWriteHeader(int fd, const Grid *u, const GridInfo *info);
+int gridWriteBinaryRows(int fd, const Grid *u, int first, int last, size_t offset);
+int gridWriteAt(int fd, const void *buf, size_t size, off_t at);
+
+#endif
@@ -2,17 +2,22 @@
 # include <stdio.h>
 # include <math.h>
 # include <time.h>
+# include "libheat2d.h"
 # include "heat2d_solver.h" 
+# include "heat2d_kernel.h"
+# include "multigrid.h"
+# include "heat2d_pcg.h"
+# include "heat2d_resolve.h"
 
 double cpu_time ( void );
-void initialize_plate(int M, int N, double Tl, double Tr, 
-		double Tt, double Tb, double **u);
+double wall_time ( void );
 
 /******************************************************************************/
 
 int usage()
 {
-	fprintf(stderr, "usage: heat2d M N Tl Tr Tt Tb eps file\n");
+	fprintf(stderr, "usage: heat2d M N Tl Tr Tt Tb eps file [options]\n");
+	optionsUsage(stderr);
 	exit(-1);
 }
 
@@ -91,81 +96,125 @@ int main ( int argc, char *argv[] )
 	double ctime;
 	double ctime1;
 	double ctime2;
-	double eps;
-	FILE *fp;
-	int M;
-	int N;
-	int i,j;
+	double wtime;
 	char *output_file;
-	double **u;
-	double Tl,Tr,Tt,Tb;
+	Heat2dConfig cfg;
+	Options *opts = &cfg.opts;
+	Heat2d *h;
+	int iters;
+	double tol;
 
+	heat2dConfigDefault(&cfg);
+	argc = parseOptions(argc, argv, opts);
 	if (argc < 9) usage();
-	M = atoi(argv[1]);
-	N = atoi(argv[2]);
-	Tl = atof(argv[3]);
-	Tr = atof(argv[4]);
-	Tt = atof(argv[5]);
-	Tb = atof(argv[6]);
-	eps = atof(argv[7]);
+	cfg.M = atoi(argv[1]);
+	cfg.N = atoi(argv[2]);
+	cfg.Tl = atof(argv[3]);
+	cfg.Tr = atof(argv[4]);
+	cfg.Tt = atof(argv[5]);
+	cfg.Tb = atof(argv[6]);
+	cfg.eps = atof(argv[7]);
 	output_file = argv[8];
+	cfg.threads = 0;
+	cfg.print = 1;
+	//heat2dCreate rejects the solver options that need threads; these two
+	//are modes of the threaded front end
+	if (opts->batch != NULL || opts->serve != NULL)
+	{
+		fprintf(stderr, "heat2d: --batch and --serve need the threaded program\n");
+		exit(-1);
+	}
+	if (heat2dKernelInit(opts->kernel) != 0)
+	{
+		fprintf(stderr, "heat2d: kernel '%s' is not available on this CPU\n", opts->kernel);
+		exit(-1);
+	}
 
 	printf ( "HEAT2D\n" );
 	printf ( "  C version\n" );
 	printf ( "  A program to solve for the steady state temperature distribution\n" );
 	printf ( "  over a rectangular plate.\n" );
-	printf ( "  Spatial grid of %d by %d points.\n", M, N );
+	printf ( "  Spatial grid of %d by %d points.\n", cfg.M, cfg.N );
+	printf ( "  Stencil kernel: %s\n", heat2dKernelName ( ) );
+	if (opts->method == METHOD_SOR)
+		printf ( "  Red-black SOR, omega = %f\n", optionsOmega ( opts, cfg.M, cfg.N ) );
+	if (opts->precision != PRECISION_DOUBLE)
+		printf ( "  Precision: %s\n", (opts->precision == PRECISION_FLOAT) ? "float" :
+				"mixed (float, then double)" );
+	else if (opts->method == METHOD_MG)
+		printf ( "  Multigrid, %s\n", (opts->mgCycle == MG_FMG) ? "FMG + V-cycles" : "V-cycles" );
+	else if (opts->method == METHOD_CG)
+		printf ( "  Conjugate gradient, %s preconditioner\n",
+				(opts->precond == PCG_SSOR) ? "SSOR" : "Jacobi" );
 	printf ( "\n" );
 
-	u = (double **) malloc(M*sizeof(double *));
-	for (i = 0; i < M; i ++) {
-		u[i] = (double *) malloc(N  * sizeof(double));
-	}
-	/** Note: u[i][j] = *( *(arr +i) + j) **/
-	printf ( "  The iteration will be repeated until the change is <= %G\n", eps );
-	printf ( "  Boundary Temperatures  left: %G  right: %G\n", Tl, Tr );
+	/** Note: u[i][j] = GRID_ROW(heat2dPlate(h), i)[j] **/
+	printf ( "  The iteration will be repeated until the change is <= %G\n", cfg.eps );
+	printf ( "  Boundary Temperatures  left: %G  right: %G\n", cfg.Tl, cfg.Tr );
 	printf ( "  The steady state solution will be written to '%s'.\n", output_file );
 
 	/* Set the boundary values, which don't change.  */
-	initialize_plate(M,N,Tl,Tr,Tt,Tb,u);
+	h = heat2dCreate(&cfg);
+	if (h == NULL)
+		exit(-1);
+	printf ( "  Initial guess: %s\n", opts->init );
+	wtime = wall_time ( );
 	ctime1 = cpu_time ( );
-	int iters;
-	double tol;
-	iters = heat2dSolve(M, N, eps, 1, u, &tol);
+	if (heat2dRun(h) < 0)
+		exit(-1);
 	ctime2 = cpu_time ( );
 	ctime = ctime2 - ctime1;
+	wtime = wall_time ( ) - wtime;
+	iters = heat2dIterations(h);
+	tol = heat2dChange(h);
 
 	printf ( "\n  %8d  %f\n", iters, tol );
 	printf ( "\n  Error tolerance achieved.\n" );
 	printf ( "  CPU time = %f\n", ctime );
+	printf ( "  Wall time = %f\n", wtime );
 
 	/* Write the solution to the output file.  */
-	fp = fopen ( output_file, "w" );
+	if (heat2dWrite(h, output_file) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot write '%s'\n", output_file);
+		exit(-1);
+	}
 
-	fprintf ( fp, "%d\n", M );
-	fprintf ( fp, "%d\n", N );
+	printf ( "\n" );
+	if (opts->asyncWrite)
+		printf ("  Solution is being written to '%s' in the background\n", output_file );
+	else
+		printf ("  Solution written to the output file '%s'\n", output_file );
 
-	for ( i = 0; i < M; i++ )
+	if (opts->resolve != NULL)
 	{
-		for ( j = 0; j < N; j++)
+		double scale = 2.0 * (fabs(cfg.Tl) + fabs(cfg.Tr) + fabs(cfg.Tt) + fabs(cfg.Tb));
+		int failed;
+
+		printf ( "\n  Boundary changes from '%s'%s\n", opts->resolve,
+				opts->superpose ? ", superposed" : "" );
+		failed = resolveRun(h, opts->resolve, cfg.eps,
+				opts->superpose ? ((scale > 0) ? scale : 1.0) : 0.0, stdout);
+		if (failed != 0)
 		{
-			fprintf ( fp, "%15.7f ", u[i][j] );
+			if (failed > 0)
+				fprintf(stderr, "heat2d: %d boundary changes failed\n", failed);
+			exit(-1);
 		}
-		fputc ( '\n', fp);
 	}
-	fclose ( fp );
-
-	printf ( "\n" );
-	printf ("  Solution written to the output file '%s'\n", output_file );
 
 	/* All done!  */
 	printf ( "\n" );
 	printf ( "HEAT2D:\n" );
 	printf ( "  Normal end of execution.\n" );
 
-	for (i = 0; i < M; i++)
-		free(u[i]);
-	free(u);
+	//The background write has to finish before the process exits
+	if (heat2dFlush(h) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot write '%s'\n", output_file);
+		exit(-1);
+	}
+	heat2dDestroy(h);
 	return 0;
 }
 /******************************************************************************/
@@ -189,48 +238,12 @@ double cpu_time ( void )
 	return value;
 }
 
-/******************************************************************************/
-/* Initialize the plate with boundary and mean temperature */
-/******************************************************************************/
-void initialize_plate(int M, int N, double Tl, double Tr, double Tt,
-		double Tb, double **u)
+/*
+ * Wall clock time in seconds: unlike cpu_time, it shows what the threads gain
+ */
+double wall_time ( void )
 {
-	int i, j;
-	for ( i = 1; i < M - 1; i++ )
-	{
-		u[i][0] = Tl;
-		u[i][N-1] = Tr;
-	}
-	for ( j = 0; j < N; j++ )
-	{
-		u[0][j] = Tt;
-		u[M-1][j] = Tb;
-	}
-	/*
-	   Average the boundary values, to come up with a reasonable
-	   initial value for the interior.
-	   */
-	double mean = 0.0;
-	for ( i = 1; i < M - 1; i++ )
-	{
-		mean += u[i][0];
-		mean += u[i][N-1];
-	}
-	for ( j = 0; j < N; j++ )
-	{
-		mean += u[0][j];
-		mean += u[M-1][j];
-	}
-	mean = mean / ( double ) ( 2 * M + 2 * N - 4 );
-	/* 
-	   Initialize the interior solution to the mean value.
-	   */
-	for ( i = 1; i < M - 1; i++ )
-	{
-		for ( j = 1; j < N - 1; j++ )
-		{
-			u[i][j] = mean;
-		}
-	}
-	return;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
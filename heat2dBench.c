@@ -0,0 +1,424 @@
+/*
+ *	Benchmark harness of the heat2d solvers
+ *
+ *	Solves square plates over a range of sizes and thread counts through
+ *	libheat2d and times every heat2dRun() on the wall clock (the "CPU time"
+ *	of heat2d adds up all the threads, so it cannot show a speedup). Each
+ *	case runs a few warmup solves first and then the timed repetitions; the
+ *	median is reported, with
+ *
+ *	sweeps/s - iterations (multigrid: cycles) per second
+ *	MLUPS - million interior point updates per second
+ *	GB/s - one read and one write of every interior point per iteration:
+ *		the least traffic of a sweep, so temporal blocking can exceed the
+ *		memory bandwidth, and multigrid cycles count their finest level only
+ *
+ *	Results go to stdout as a table and, with --json / --csv, to files that
+ *	can be kept and compared between builds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "libheat2d.h"
+#include "heat2d_solver.h"
+#include "heat2d_kernel.h"
+#include "heat2d_pcg.h"
+
+#define BENCH_MAX_VALUES 256
+
+typedef struct {
+	int M, N;
+	int threads;		//0 = serial solvers
+	int iterations;
+	double wallMin;		//seconds, over the timed repetitions
+	double wallMedian;
+	double cpuMedian;	//CPU time of the process, all threads together
+	double sweepsPerSec;
+	double mlups;
+	double gbps;
+} BenchResult;
+
+typedef struct {
+	int sizes[BENCH_MAX_VALUES];
+	int sizeCount;
+	int threads[BENCH_MAX_VALUES];
+	int threadCount;
+	int reps;
+	int warmup;
+	double eps;
+	double Tl, Tr, Tt, Tb;
+	const char *json;	//NULL = no JSON file
+	const char *csv;	//NULL = no CSV file
+} BenchSetup;
+
+double cpu_time ( void );
+double wall_time ( void );
+
+int usage()
+{
+	fprintf(stderr, "usage: heat2dBench [bench options] [options]\n");
+	fprintf(stderr, "bench options:\n");
+	fprintf(stderr, "  --sweep=serial|para|thread        the cases of the old scripts: sizes 200..4000\n");
+	fprintf(stderr, "                                    serially or on 4 threads, or 2000 on 2..12\n");
+	fprintf(stderr, "  --sizes=LIST                      plate sizes, e.g. 200-4000:200 or 500,1000\n");
+	fprintf(stderr, "                                    (default: 500,1000,2000)\n");
+	fprintf(stderr, "  --threads=LIST                    thread counts, 0 = serial solvers (default: 1)\n");
+	fprintf(stderr, "  --reps=R                          timed solves per case (default: 3)\n");
+	fprintf(stderr, "  --warmup=W                        untimed solves per case first (default: 1)\n");
+	fprintf(stderr, "  --eps=E                           tolerance (default: 0.001)\n");
+	fprintf(stderr, "  --plate=Tl,Tr,Tt,Tb               boundary temperatures (default: 100,100,50,69)\n");
+	fprintf(stderr, "  --json=FILE                       also write the results as JSON\n");
+	fprintf(stderr, "  --csv=FILE                        also write the results as CSV\n");
+	optionsUsage(stderr);
+	exit(-1);
+}
+
+/*
+ * Parse a list of non-negative integers: "A,B,C", ranges "A-B" and
+ * stepped ranges "A-B:S" can be mixed
+ * Return: number of values, -1 if spec is malformed or too long
+ */
+static int parseList(const char *spec, int *values)
+{
+	const char *p = spec;
+	int count = 0;
+
+	while (*p != '\0')
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		long last = first, step = 1;
+		long v;
+
+		if (end == p || first < 0)
+			return -1;
+		if (*end == '-')
+		{
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				return -1;
+			if (*end == ':')
+			{
+				p = end + 1;
+				step = strtol(p, &end, 10);
+				if (end == p || step < 1)
+					return -1;
+			}
+		}
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return -1;
+		p = end;
+		for (v = first; v <= last; v += step)
+		{
+			if (count == BENCH_MAX_VALUES)
+				return -1;
+			values[count++] = (int) v;
+		}
+	}
+	return count;
+}
+
+/*
+ * Take the bench options out of argv, leaving the solver options for
+ * parseOptions()
+ * Return: the new argc, -1 on a bad value
+ */
+static int parseBench(int argc, char *argv[], BenchSetup *b)
+{
+	int i, kept = 1;
+
+	for (i = 1; i < argc; i++)
+	{
+		char *arg = argv[i];
+		char *value = strchr(arg, '=');
+		size_t len = (value != NULL) ? (size_t) (value - arg) : strlen(arg);
+		int bad = 0;
+
+		if (value != NULL)
+			value++;
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+			usage();
+		if (value == NULL)
+			argv[kept++] = arg;
+		else if (len == 7 && strncmp(arg, "--sweep", len) == 0)
+		{
+			if (strcmp(value, "serial") == 0 || strcmp(value, "para") == 0)
+			{
+				b->sizeCount = parseList("200-4000:200", b->sizes);
+				b->threadCount = parseList((value[0] == 's') ? "0" : "4", b->threads);
+			}
+			else if (strcmp(value, "thread") == 0)
+			{
+				b->sizeCount = parseList("2000", b->sizes);
+				b->threadCount = parseList("2-12", b->threads);
+			}
+			else
+				bad = 1;
+		}
+		else if (len == 7 && strncmp(arg, "--sizes", len) == 0)
+			bad = ((b->sizeCount = parseList(value, b->sizes)) < 1);
+		else if (len == 9 && strncmp(arg, "--threads", len) == 0)
+			bad = ((b->threadCount = parseList(value, b->threads)) < 1);
+		else if (len == 6 && strncmp(arg, "--reps", len) == 0)
+			bad = ((b->reps = atoi(value)) < 1);
+		else if (len == 8 && strncmp(arg, "--warmup", len) == 0)
+			bad = ((b->warmup = atoi(value)) < 0);
+		else if (len == 5 && strncmp(arg, "--eps", len) == 0)
+			bad = ((b->eps = atof(value)) <= 0);
+		else if (len == 7 && strncmp(arg, "--plate", len) == 0)
+			bad = (sscanf(value, "%lf,%lf,%lf,%lf", &b->Tl, &b->Tr, &b->Tt, &b->Tb) != 4);
+		else if (len == 6 && strncmp(arg, "--json", len) == 0)
+			b->json = value;
+		else if (len == 5 && strncmp(arg, "--csv", len) == 0)
+			b->csv = value;
+		else
+			argv[kept++] = arg;
+		if (bad)
+		{
+			fprintf(stderr, "bad value in '%s'\n", arg);
+			return -1;
+		}
+	}
+	argv[kept] = NULL;
+	return kept;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Time the solves of one case into r
+ * Return: 0, -1 if the plate could not be set up
+ */
+static int benchCase(const BenchSetup *b, const Options *opts, int size, int threads,
+		BenchResult *r)
+{
+	double wall[BENCH_MAX_VALUES];
+	double cpu[BENCH_MAX_VALUES];
+	Heat2dConfig cfg;
+	double points;
+	int elem = (opts->precision == PRECISION_FLOAT) ? sizeof(float) : sizeof(double);
+	int rep;
+
+	heat2dConfigDefault(&cfg);
+	cfg.M = cfg.N = size;
+	cfg.Tl = b->Tl;
+	cfg.Tr = b->Tr;
+	cfg.Tt = b->Tt;
+	cfg.Tb = b->Tb;
+	cfg.eps = b->eps;
+	cfg.threads = threads;
+	cfg.opts = *opts;
+
+	for (rep = -b->warmup; rep < b->reps; rep++)
+	{
+		Heat2d *h = heat2dCreate(&cfg);
+		double w, c;
+
+		if (h == NULL)
+			return -1;
+		w = wall_time ( );
+		c = cpu_time ( );
+		heat2dRun(h);
+		c = cpu_time ( ) - c;
+		w = wall_time ( ) - w;
+		r->iterations = heat2dIterations(h);
+		heat2dDestroy(h);
+		if (rep >= 0)
+		{
+			wall[rep] = w;
+			cpu[rep] = c;
+		}
+	}
+
+	qsort(wall, b->reps, sizeof(double), compareDouble);
+	qsort(cpu, b->reps, sizeof(double), compareDouble);
+	r->M = r->N = size;
+	r->threads = threads;
+	r->wallMin = wall[0];
+	r->wallMedian = wall[b->reps / 2];
+	r->cpuMedian = cpu[b->reps / 2];
+	points = (size > 2) ? (double) (size - 2) * (size - 2) : 0.0;
+	r->sweepsPerSec = (r->wallMedian > 0) ? r->iterations / r->wallMedian : 0.0;
+	r->mlups = r->sweepsPerSec * points / 1e6;
+	r->gbps = r->sweepsPerSec * points * 2 * elem / 1e9;
+	return 0;
+}
+
+static const char *methodName(const Options *opts)
+{
+	if (opts->method == METHOD_SOR)
+		return "sor";
+	if (opts->method == METHOD_MG)
+		return "mg";
+	if (opts->method == METHOD_CG)
+		return opts->precond == PCG_SSOR ? "cg-ssor" : "cg-jacobi";
+	return "jacobi";
+}
+
+static const char *precisionName(const Options *opts)
+{
+	if (opts->precision == PRECISION_FLOAT)
+		return "float";
+	if (opts->precision == PRECISION_MIXED)
+		return "mixed";
+	return "double";
+}
+
+static int writeJSON(const char *path, const BenchSetup *b, const Options *opts,
+		const BenchResult *r, int count)
+{
+	FILE *fp = fopen(path, "w");
+	char stamp[32];
+	time_t now = time(NULL);
+	int k;
+
+	if (fp == NULL)
+		return -1;
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"benchmark\": \"heat2d\",\n");
+	fprintf(fp, "  \"date\": \"%s\",\n", stamp);
+	fprintf(fp, "  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+	fprintf(fp, "  \"kernel\": \"%s\",\n", heat2dKernelName());
+	fprintf(fp, "  \"method\": \"%s\",\n", methodName(opts));
+	fprintf(fp, "  \"precision\": \"%s\",\n", precisionName(opts));
+	fprintf(fp, "  \"eps\": %g,\n", b->eps);
+	fprintf(fp, "  \"plate\": [%g, %g, %g, %g],\n", b->Tl, b->Tr, b->Tt, b->Tb);
+	fprintf(fp, "  \"reps\": %d,\n", b->reps);
+	fprintf(fp, "  \"warmup\": %d,\n", b->warmup);
+	fprintf(fp, "  \"results\": [\n");
+	for (k = 0; k < count; k++)
+		fprintf(fp, "    {\"M\": %d, \"N\": %d, \"threads\": %d, \"iterations\": %d, "
+				"\"wall_min\": %.6f, \"wall_median\": %.6f, \"cpu_median\": %.6f, "
+				"\"sweeps_per_s\": %.3f, \"mlups\": %.3f, \"gbps\": %.3f}%s\n",
+				r[k].M, r[k].N, r[k].threads, r[k].iterations, r[k].wallMin,
+				r[k].wallMedian, r[k].cpuMedian, r[k].sweepsPerSec, r[k].mlups, r[k].gbps,
+				(k + 1 < count) ? "," : "");
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+	return (fclose(fp) == 0) ? 0 : -1;
+}
+
+static int writeCSV(const char *path, const Options *opts, const BenchResult *r, int count)
+{
+	FILE *fp = fopen(path, "w");
+	int k;
+
+	if (fp == NULL)
+		return -1;
+	fprintf(fp, "kernel,method,precision,M,N,threads,iterations,wall_min,wall_median,"
+			"cpu_median,sweeps_per_s,mlups,gbps\n");
+	for (k = 0; k < count; k++)
+		fprintf(fp, "%s,%s,%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.3f,%.3f,%.3f\n",
+				heat2dKernelName(), methodName(opts), precisionName(opts), r[k].M, r[k].N,
+				r[k].threads, r[k].iterations, r[k].wallMin, r[k].wallMedian,
+				r[k].cpuMedian, r[k].sweepsPerSec, r[k].mlups, r[k].gbps);
+	return (fclose(fp) == 0) ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchSetup b;
+	Options opts;
+	BenchResult *results;
+	int count = 0;
+	int s, t;
+
+	memset(&b, 0, sizeof(b));
+	b.sizeCount = parseList("500,1000,2000", b.sizes);
+	b.threadCount = parseList("1", b.threads);
+	b.reps = 3;
+	b.warmup = 1;
+	b.eps = 0.001;
+	b.Tl = 100;
+	b.Tr = 100;
+	b.Tt = 50;
+	b.Tb = 69;
+
+	argc = parseBench(argc, argv, &b);
+	if (argc < 0) usage();
+	optionsDefault(&opts);
+	argc = parseOptions(argc, argv, &opts);
+	if (argc != 1 || b.reps > BENCH_MAX_VALUES) usage();
+	if (heat2dKernelInit(opts.kernel) != 0)
+	{
+		fprintf(stderr, "heat2d: kernel '%s' is not available on this CPU\n", opts.kernel);
+		exit(-1);
+	}
+	results = malloc(b.sizeCount * b.threadCount * sizeof(BenchResult));
+	if (results == NULL)
+		exit(-1);
+
+	printf ( "HEAT2D benchmark\n" );
+	printf ( "  Stencil kernel: %s, method: %s, precision: %s\n", heat2dKernelName ( ),
+			methodName ( &opts ), precisionName ( &opts ) );
+	printf ( "  eps %G, %d warmup and %d timed solves per case, median reported\n",
+			b.eps, b.warmup, b.reps );
+	printf ( "\n      Size  Threads  Iterations  Wall (s)   CPU (s)    Sweeps/s     MLUPS     GB/s\n" );
+	for (s = 0; s < b.sizeCount; s++)
+		for (t = 0; t < b.threadCount; t++)
+		{
+			BenchResult *r = &results[count];
+			if (benchCase(&b, &opts, b.sizes[s], b.threads[t], r) != 0)
+				exit(-1);
+			printf ( "  %8d  %7d  %10d  %8.4f  %8.4f  %10.1f  %8.1f  %7.2f\n", r->M,
+					r->threads, r->iterations, r->wallMedian, r->cpuMedian,
+					r->sweepsPerSec, r->mlups, r->gbps );
+			fflush(stdout);
+			count++;
+		}
+
+	if (b.json != NULL && writeJSON(b.json, &b, &opts, results, count) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot write '%s'\n", b.json);
+		exit(-1);
+	}
+	if (b.csv != NULL && writeCSV(b.csv, &opts, results, count) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot write '%s'\n", b.csv);
+		exit(-1);
+	}
+	free(results);
+	return 0;
+}
+
+/******************************************************************************/
+/*
+Purpose:
+CPU_TIME returns the current reading on the CPU clock.
+Licensing:
+This code is distributed under the GNU LGPL license.
+Modified:
+06 June 2005
+Author:
+John Burkardt
+Parameters:
+Output, double CPU_TIME, the current reading of the CPU clock, in seconds.
+*/
+/******************************************************************************/
+double cpu_time ( void )
+{
+	double value;
+	value = ( double ) clock ( ) / ( double ) CLOCKS_PER_SEC;
+	return value;
+}
+
+/*
+ * Wall clock time in seconds
+ */
+double wall_time ( void )
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,520 @@
+/*
+ *	MPI version of heatmap 2D
+ *
+ *	The plate is cut into the row strips of the threaded program, one per
+ *	rank, and each rank holds only its strip plus one halo row above and
+ *	below it, twice over for ping-pong Jacobi sweeps. A plate too large for
+ *	one machine is spread over the memory and the memory bandwidth of all
+ *	of them.
+ *
+ *	Every sweep starts by posting the halo exchange: the first and last row
+ *	of the strip go to the neighbours, and their rows copyStart-1 and
+ *	copyEnd arrive in the halo rows. Those only feed the two rows next to
+ *	them, so the rest of the strip is swept while the messages are on the
+ *	way, and only the two edge rows wait for them. The max change of a
+ *	checked sweep is combined with MPI_Allreduce, the residual norms from
+ *	the per-row norms of every rank in plate order, so the iterations and
+ *	the plate are the same as with the threaded solver on any number of
+ *	ranks or threads.
+ *
+ *	Each rank writes its own rows of the solution file, which has to be on
+ *	a file system all ranks see.
+ *
+ *	mpirun -np 4 ./heat2dMPI 4000 4000 100 10 50 50 0.001 plate.out
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "heat2d_solver.h"
+#include "heat2d_kernel.h"
+#include "heat2d_options.h"
+
+//Tags of the halo rows: sent to the rank below, or to the rank above
+#define HALO_DOWN 1
+#define HALO_UP 2
+
+//This rank's part of the plate
+typedef struct {
+	int rank;
+	int ranks;
+	int M, N;		//the whole plate
+	int copyStart;	//rows copyStart..copyEnd-1 of the plate are the strip
+	int copyEnd;
+	int rows;		//copyEnd - copyStart, 0 if there are more ranks than rows
+	int up;			//ranks holding rows copyStart-1 and copyEnd,
+	int down;		//MPI_PROC_NULL at the edges of the plate
+	int first;		//strip rows swept, 1 = row copyStart; first > last
+	int last;		//if the strip is all boundary
+	Grid u, v;		//rows + 2 rows: halo, the strip, halo
+} Strip;
+
+double cpu_time ( void );
+
+int rank;
+
+int usage()
+{
+	if (rank == 0)
+	{
+		fprintf(stderr, "usage: mpirun -np RANKS heat2dMPI M N Tl Tr Tt Tb eps file [options]\n");
+		fprintf(stderr, "options:\n");
+		fprintf(stderr, "  --kernel=auto|scalar|avx2|avx512  stencil kernel (default: auto)\n");
+		fprintf(stderr, "  --check=K|auto                    check convergence every K sweeps, or at\n");
+		fprintf(stderr, "                                    adaptive intervals (default: 1)\n");
+		fprintf(stderr, "  --norm=delta|linf|l2              measure compared with eps: largest change of\n");
+		fprintf(stderr, "                                    a sweep, or max / RMS residual (default: delta)\n");
+		fprintf(stderr, "  --format=binary|text              solution file format (default: binary)\n");
+		fprintf(stderr, "the other options of heat2d need the threaded program\n");
+	}
+	MPI_Finalize();
+	exit(-1);
+}
+
+/*
+ *	Rows copyStart..copyEnd-1 of the strip of rank r, cut like the strips
+ *	of the threaded program
+ */
+static void stripRows(int M, int r, int ranks, int *copyStart, int *copyEnd)
+{
+	int step = (M + ranks - 1) / ranks;
+
+	*copyStart = (r * step < M) ? r * step : M;
+	*copyEnd = (*copyStart + step < M) ? *copyStart + step : M;
+}
+
+/*
+ *	Cut out this rank's strip and allocate its two plates
+ *	Return: 0, -1 if they cannot be allocated
+ */
+static int stripInit(Strip *s, int M, int N)
+{
+	MPI_Comm_rank(MPI_COMM_WORLD, &s->rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &s->ranks);
+	s->M = M;
+	s->N = N;
+	stripRows(M, s->rank, s->ranks, &s->copyStart, &s->copyEnd);
+	s->rows = s->copyEnd - s->copyStart;
+	s->up = (s->rows > 0 && s->copyStart > 0) ? s->rank - 1 : MPI_PROC_NULL;
+	s->down = (s->rows > 0 && s->copyEnd < M) ? s->rank + 1 : MPI_PROC_NULL;
+	s->first = (s->copyStart == 0) ? 2 : 1;
+	s->last = (s->copyEnd >= M) ? s->rows - 1 : s->rows;
+	s->u.data = NULL;
+	s->v.data = NULL;
+	if (gridAlloc(&s->u, s->rows + 2, N) != 0 || gridAlloc(&s->v, s->rows + 2, N) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+ *	Fill the strip with the initial plate of initialize_plate: the
+ *	boundary, and the mean boundary temperature inside
+ */
+static void stripFill(Strip *s, double Tl, double Tr, double Tt, double Tb)
+{
+	Grid plate = { s->M, s->N, 0, NULL };
+	double mean = plateMean(&plate, Tl, Tr, Tt, Tb);
+	int N = s->N;
+	int i, j, k;
+
+	for (k = 1; k <= s->rows; k++)
+	{
+		double *row = GRID_ROW(&s->u, k);
+
+		i = s->copyStart + k - 1;
+		if (i == s->M - 1 || i == 0)
+		{
+			double T = (i == s->M - 1) ? Tb : Tt;
+			for (j = 0; j < N; j++)
+				row[j] = T;
+		}
+		else
+		{
+			for (j = 0; j < N; j++)
+				row[j] = mean;
+			row[0] = Tl;
+			row[N-1] = Tr;
+		}
+		//The boundary of v never changes either
+		memcpy(GRID_ROW(&s->v, k), row, N * sizeof(double));
+	}
+}
+
+/*
+ *	Post the exchange of the halo rows of src: the edge rows of the strip
+ *	go out, the neighbours' rows come into rows 0 and rows + 1
+ */
+static void haloStart(Strip *s, Grid *src, MPI_Request req[4])
+{
+	int N = s->N;
+
+	MPI_Irecv(GRID_ROW(src, 0), N, MPI_DOUBLE, s->up, HALO_DOWN, MPI_COMM_WORLD, &req[0]);
+	MPI_Irecv(GRID_ROW(src, s->rows + 1), N, MPI_DOUBLE, s->down, HALO_UP, MPI_COMM_WORLD,
+			&req[1]);
+	MPI_Isend(GRID_ROW(src, 1), N, MPI_DOUBLE, s->up, HALO_UP, MPI_COMM_WORLD, &req[2]);
+	MPI_Isend(GRID_ROW(src, s->rows), N, MPI_DOUBLE, s->down, HALO_DOWN, MPI_COMM_WORLD,
+			&req[3]);
+}
+
+/*
+ *	One ping-pong Jacobi sweep of the strip from src into dst. The rows
+ *	that don't read a halo row are swept while the halo rows of src are
+ *	exchanged; the two edge rows follow once they have arrived.
+ *	Return: the largest change in the strip (0 unless check)
+ */
+static double stripSweep(Strip *s, Grid *dst, Grid *src, int check)
+{
+	MPI_Request req[4];
+	int lo = (s->first > 2) ? s->first : 2;
+	int hi = (s->last < s->rows - 1) ? s->last : s->rows - 1;
+	double diff = 0.0, delta;
+
+	haloStart(s, src, req);
+	if (lo <= hi)
+		diff = heat2dSweepPingPong(dst, src, NULL, lo, hi, check);
+	MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+	if (s->first <= 1 && 1 <= s->last)
+	{
+		delta = heat2dSweepPingPong(dst, src, NULL, 1, 1, check);
+		if (delta > diff)
+			diff = delta;
+	}
+	if (s->rows > 1 && s->first <= s->rows && s->rows <= s->last)
+	{
+		delta = heat2dSweepPingPong(dst, src, NULL, s->rows, s->rows, check);
+		if (delta > diff)
+			diff = delta;
+	}
+	return diff;
+}
+
+/*
+ *	Residual norm of the plate in src: every rank computes the norms of its
+ *	rows, and all of them combine the rows of the whole plate in order, as
+ *	heat2dResidualNorm does for the threads
+ *	local - rows + 2 row norms of this rank
+ *	rowNorm - M row norms of the plate
+ */
+static double stripResidual(Strip *s, Grid *src, int norm, double *local, double *rowNorm,
+		int *counts, int *displs)
+{
+	Grid plate = { s->M, s->N, 0, NULL };
+	MPI_Request req[4];
+
+	haloStart(s, src, req);
+	MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+	if (s->first <= s->last)
+		heat2dResidualRows(src, s->first, s->last, norm, local);
+	MPI_Allgatherv(local + 1, s->rows, MPI_DOUBLE, rowNorm, counts, displs, MPI_DOUBLE,
+			MPI_COMM_WORLD);
+	return heat2dResidualNorm(&plate, norm, rowNorm);
+}
+
+/* heat2dSolvePingPong over the strips of all ranks
+ *	Return: number of iterations that it took; the plate is in s->u
+ */
+static int stripSolve(Strip *s, double eps, const CheckPolicy *policy, int print, double *tol)
+{
+	int iterations = 0;
+	int iterations_print = 1;
+	Grid *src = &s->u, *dst = &s->v, *tmp;
+	double global = 2.0 * eps;
+	double *local = NULL, *rowNorm = NULL;
+	int *counts = NULL, *displs = NULL;
+	Convergence conv;
+	int r, k;
+
+	if (policy->norm != CHECK_DELTA)
+	{
+		local = calloc(s->rows + 2, sizeof(double));
+		rowNorm = calloc(s->M, sizeof(double));
+		counts = malloc(s->ranks * sizeof(int));
+		displs = malloc(s->ranks * sizeof(int));
+		for (r = 0; r < s->ranks; r++)
+		{
+			int copyStart, copyEnd;
+			stripRows(s->M, r, s->ranks, &copyStart, &copyEnd);
+			counts[r] = copyEnd - copyStart;
+			displs[r] = copyStart;
+		}
+	}
+
+	if (print && s->rank == 0)
+		printf( "\n Iteration  Change\n" );
+
+	convergeInit(&conv, policy);
+	while ( eps <= global && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+		double diff = stripSweep(s, dst, src, check && conv.policy.norm == CHECK_DELTA);
+
+		tmp = src; src = dst; dst = tmp;
+		iterations++;
+		if (!check)
+			continue;
+		if (conv.policy.norm == CHECK_DELTA)
+			MPI_Allreduce(&diff, &global, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+		else
+			global = stripResidual(s, src, conv.policy.norm, local, rowNorm, counts, displs);
+		convergeUpdate(&conv, iterations, global, eps);
+
+		if ( print && iterations >= iterations_print )
+		{
+			if (s->rank == 0)
+				printf ( "  %8d  %f\n", iterations, global );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	//The last sweep may have written v
+	if (src != &s->u)
+		for (k = 1; k <= s->rows; k++)
+			memcpy(GRID_ROW(&s->u, k), GRID_ROW(src, k), s->N * sizeof(double));
+	free(local);
+	free(rowNorm);
+	free(counts);
+	free(displs);
+	*tol = global;
+	return iterations;
+}
+
+/*
+ *	Write the solution file with every rank writing its strip at its offset:
+ *	rank 0 creates the file and writes the header first. Text rows have a
+ *	fixed length as long as every value fits in 15 characters; if one does
+ *	not, every rank formats its rows with gridWriteTextBody instead and
+ *	finds its offset from the lengths of the ranks before it.
+ *	Return: 0 on every rank, or -1 on every rank if the file could not be
+ *	written
+ */
+static int stripWrite(Strip *s, const char *path, const GridInfo *info, int format)
+{
+	Grid plate = { s->M, s->N, 0, NULL };
+	Grid strip = s->u;		/* the strip without its halo rows */
+	char header[32];
+	size_t length = (format == GRID_FORMAT_TEXT) ?
+		(size_t) gridTextHeader(header, sizeof(header), &plate) : GRID_HEADER_SIZE;
+	int status = 0, result, closed;
+	int fd = -1;
+
+	strip.M = s->rows;
+	strip.data = GRID_ROW(&s->u, 1);
+	if (s->rank == 0)
+	{
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			status = -1;
+		else if (format == GRID_FORMAT_TEXT)
+			status = gridWriteAt(fd, header, length, 0);
+		else
+			status = gridWriteHeader(fd, &plate, info);
+	}
+	MPI_Allreduce(&status, &result, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+	if (result != 0)
+	{
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (s->rank != 0)
+	{
+		fd = open(path, O_WRONLY);
+		if (fd < 0)
+			status = -1;
+	}
+
+	if (status == 0 && s->rows > 0)
+	{
+		if (format == GRID_FORMAT_TEXT)
+			status = gridWriteTextRows(fd, &strip, 0, s->rows - 1,
+					length + (size_t) s->copyStart * GRID_TEXT_ROW(s->N));
+		else
+			status = gridWriteBinaryRows(fd, &strip, 0, s->rows - 1,
+					length + (size_t) s->copyStart * s->N * sizeof(double));
+	}
+	MPI_Allreduce(&status, &result, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+	if (result != 0 && format == GRID_FORMAT_TEXT)
+	{
+		//Some value is too wide for the fixed layout (or a write failed)
+		char *buf = NULL;
+		size_t size = 0;
+		unsigned long long mine, before = 0, total = 0;
+		FILE *fp = open_memstream(&buf, &size);
+
+		status = (fd < 0) ? -1 : 0;
+		if (fp == NULL)
+			status = -1;
+		else
+		{
+			gridWriteTextBody(fp, &strip);
+			if (fclose(fp) != 0)
+				status = -1;
+		}
+		mine = (status == 0) ? size : 0;
+		MPI_Exscan(&mine, &before, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+		MPI_Allreduce(&mine, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+		if (s->rank == 0)
+			before = 0;
+		if (status == 0 && gridWriteAt(fd, buf, size, (off_t) (length + before)) != 0)
+			status = -1;
+		if (status == 0 && s->rank == 0 && ftruncate(fd, (off_t) (length + total)) != 0)
+			status = -1;
+		free(buf);
+		MPI_Allreduce(&status, &result, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+	}
+	closed = (fd >= 0 && close(fd) != 0) ? -1 : 0;
+	MPI_Allreduce(MPI_IN_PLACE, &closed, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+	return (result != 0 || closed != 0) ? -1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	Options opts;
+	Strip s;
+	int M, N;
+	double Tl, Tr, Tt, Tb, eps;
+	char *output_file;
+	int iters;
+	double tol;
+	GridInfo info;
+
+	double ctime, ctime1, ctime2, wtime;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	//Parse inputs - Remember to check validity
+	optionsDefault(&opts);
+	argc = parseOptions(argc, argv, &opts);
+	if (argc != 9) usage();
+	M = atoi(argv[1]);
+	N = atoi(argv[2]);
+	Tl = atof(argv[3]);
+	Tr = atof(argv[4]);
+	Tt = atof(argv[5]);
+	Tb = atof(argv[6]);
+	eps = atof(argv[7]);
+	output_file = argv[8];
+
+	//error checking
+	if (M < 0 || N < 0 || eps < 0)
+		usage();
+	if (opts.method != METHOD_JACOBI || opts.tbDepth != 1 || opts.tileHeight > 0 ||
+			opts.precision != PRECISION_DOUBLE || strcmp(opts.init, "mean") != 0 ||
+			opts.geometry != NULL)
+	{
+		if (rank == 0)
+			fprintf(stderr, "heat2dMPI: only plain Jacobi sweeps from the mean are distributed;\n"
+					"--method, --tb-depth, --tile, --precision, --init and --geometry need the\n"
+					"threaded program\n");
+		MPI_Finalize();
+		exit(-1);
+	}
+	if (opts.checkpoint != NULL || opts.resume != NULL || opts.asyncWrite ||
+			opts.affinity != NULL || opts.placement || opts.batch != NULL ||
+			opts.resolve != NULL || opts.serve != NULL || opts.trace)
+	{
+		if (rank == 0)
+			fprintf(stderr, "heat2dMPI: --checkpoint, --resume, --async-write, --affinity, --placement,\n"
+					"--batch, --resolve, --serve and --trace need the threaded program\n");
+		MPI_Finalize();
+		exit(-1);
+	}
+	if (heat2dKernelInit(opts.kernel) != 0)
+	{
+		if (rank == 0)
+			fprintf(stderr, "heat2dMPI: kernel '%s' is not available on this CPU\n", opts.kernel);
+		MPI_Finalize();
+		exit(-1);
+	}
+	if (stripInit(&s, M, N) != 0)
+	{
+		fprintf(stderr, "heat2dMPI: rank %d cannot allocate its %d rows\n", rank, s.rows);
+		MPI_Abort(MPI_COMM_WORLD, -1);
+	}
+
+	if (rank == 0)
+	{
+		printf ( "HEAT2D\n" );
+		printf ( "  C version\n" );
+		printf ( "  A program to solve for the steady state temperature distribution\n" );
+		printf ( "  over a rectangular plate.\n" );
+		printf ( "  Spatial grid of %d by %d points.\n", M, N );
+		printf ( "  Stencil kernel: %s\n", heat2dKernelName ( ) );
+		printf ( "  MPI ranks: %d, %d rows each\n", s.ranks, (M + s.ranks - 1) / s.ranks );
+		printf ( "\n" );
+	}
+	stripFill(&s, Tl, Tr, Tt, Tb);
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	wtime = MPI_Wtime ( );
+	ctime1 = cpu_time ( );
+	iters = stripSolve(&s, eps, &opts.check, 1, &tol);
+	ctime2 = cpu_time ( );
+	ctime = ctime2 - ctime1;
+	wtime = MPI_Wtime ( ) - wtime;
+
+	if (rank == 0)
+	{
+		printf ( "\n  %8d  %f\n", iters, tol );
+		printf ( "\n  Error tolerance achieved.\n" );
+		printf ( "  CPU time = %f\n", ctime );
+		printf ( "  Wall time = %f\n", wtime );
+	}
+
+	/* Write the solution to the output file.  */
+	info.Tl = Tl;
+	info.Tr = Tr;
+	info.Tt = Tt;
+	info.Tb = Tb;
+	info.iterations = iters;
+	info.tol = tol;
+	if (stripWrite(&s, output_file, &info, opts.format) != 0)
+	{
+		if (rank == 0)
+			fprintf(stderr, "heat2dMPI: cannot write '%s'\n", output_file);
+		MPI_Finalize();
+		exit(-1);
+	}
+
+	if (rank == 0)
+	{
+		printf ( "\n" );
+		printf ("  Solution written to the output file '%s'\n", output_file );
+
+		/* All done!  */
+		printf ( "\n" );
+		printf ( "HEAT2D:\n" );
+		printf ( "  Normal end of execution.\n" );
+	}
+
+	gridFree(&s.u);
+	gridFree(&s.v);
+	MPI_Finalize();
+	return 0;
+}
+
+/******************************************************************************/
+/*
+Purpose:
+CPU_TIME returns the current reading on the CPU clock.
+Licensing:
+This code is distributed under the GNU LGPL license.
+Modified:
+06 June 2005
+Author:
+John Burkardt
+Parameters:
+Output, double CPU_TIME, the current reading of the CPU clock, in seconds.
+*/
+/******************************************************************************/
+double cpu_time ( void )
+{
+	double value;
+	value = ( double ) clock ( ) / ( double ) CLOCKS_PER_SEC;
+	return value;
+}
@@ -0,0 +1,254 @@
+/*
+ *	Batch mode: many plates solved on one worker pool
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "heat2d_batch.h"
+#include "libheat2d.h"
+#include "threadpool.h"
+#include "affinity.h"
+
+#define BATCH_LINE 4096
+
+//Shared by the workers of one batchRun()
+typedef struct {
+	BatchJob *jobs;
+	int *order;				//job indices, largest plate first
+	TaskQueue queue;		//hands out positions in order
+	const Options *opts;
+	FILE *report;
+	pthread_mutex_t lock;	//one report line at a time
+} Batch;
+
+/*
+ * Read the job list at path into *jobs
+ * Return: number of jobs, -1 if the file cannot be read or a line is not
+ *	a plate (reported on stderr)
+ */
+int batchRead(const char *path, BatchJob **jobs)
+{
+	FILE *fp = fopen(path, "r");
+	char buf[BATCH_LINE];
+	char file[BATCH_LINE];
+	BatchJob *list = NULL;
+	int count = 0, size = 0;
+	int line = 0;
+
+	if (fp == NULL)
+	{
+		fprintf(stderr, "heat2d: cannot open the job list '%s'\n", path);
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		BatchJob job;
+		char *comment = strchr(buf, '#');
+		int used = 0;
+
+		line++;
+		if (comment != NULL)
+			*comment = '\0';
+		if (strspn(buf, " \t\r\n") == strlen(buf))
+			continue;
+		if (sscanf(buf, "%d %d %lf %lf %lf %lf %lf %4095s %n", &job.M, &job.N, &job.Tl,
+					&job.Tr, &job.Tt, &job.Tb, &job.eps, file, &used) != 8 ||
+				buf[used] != '\0' || job.M < 0 || job.N < 0 || job.eps < 0)
+		{
+			fprintf(stderr, "heat2d: %s:%d: expected M N Tl Tr Tt Tb eps file\n", path, line);
+			batchFree(list, count);
+			fclose(fp);
+			return -1;
+		}
+		if (count == size)
+		{
+			BatchJob *grown;
+			size = (size > 0) ? 2 * size : 64;
+			grown = realloc(list, size * sizeof(BatchJob));
+			if (grown == NULL)
+			{
+				batchFree(list, count);
+				fclose(fp);
+				return -1;
+			}
+			list = grown;
+		}
+		job.path = strdup(file);
+		job.line = line;
+		job.iterations = 0;
+		job.change = 0.0;
+		job.status = -1;
+		list[count++] = job;
+		if (job.path == NULL)
+		{
+			batchFree(list, count);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	*jobs = list;
+	return count;
+}
+
+void batchFree(BatchJob *jobs, int count)
+{
+	int k;
+	for (k = 0; k < count; k++)
+		free(jobs[k].path);
+	free(jobs);
+}
+
+//Job list, set for the duration of the qsort() in batchRun()
+static const BatchJob *sortJobs;
+
+/*
+ * Largest plate first; plates of one size together, in list order
+ */
+static int compareJobs(const void *a, const void *b)
+{
+	const BatchJob *x = &sortJobs[*(const int *) a];
+	const BatchJob *y = &sortJobs[*(const int *) b];
+	long sx = (long) x->M * x->N;
+	long sy = (long) y->M * y->N;
+
+	if (sx != sy)
+		return (sx > sy) ? -1 : 1;
+	if (x->M != y->M)
+		return x->M - y->M;
+	return x->line - y->line;
+}
+
+/*
+ * Serial context for the plate of job
+ */
+static Heat2d *plateContext(const Batch *b, const BatchJob *job)
+{
+	Heat2dConfig cfg;
+
+	heat2dConfigDefault(&cfg);
+	cfg.M = job->M;
+	cfg.N = job->N;
+	cfg.Tl = job->Tl;
+	cfg.Tr = job->Tr;
+	cfg.Tt = job->Tt;
+	cfg.Tb = job->Tb;
+	cfg.eps = job->eps;
+	cfg.opts = *b->opts;
+	//The other workers' sweeps already overlap this worker's writes
+	cfg.opts.asyncWrite = 0;
+	//--affinity pins the batch pool; the plate has no threads of its own
+	cfg.opts.affinity = NULL;
+	return heat2dCreate(&cfg);
+}
+
+/*
+ * Pool job: solve plates until the queue is empty
+ */
+static void solvePlates(void *arg, int rank)
+{
+	Batch *b = (Batch *) arg;
+	Heat2d *h = NULL;
+	int k;
+
+	while ((k = taskNext(&b->queue, rank)) >= 0)
+	{
+		BatchJob *job = &b->jobs[b->order[k]];
+
+		job->status = -1;
+		if (h != NULL && (heat2dPlate(h)->M != job->M || heat2dPlate(h)->N != job->N))
+		{
+			heat2dDestroy(h);
+			h = NULL;
+		}
+		if (h == NULL)
+			h = plateContext(b, job);
+		else if (heat2dReset(h, job->Tl, job->Tr, job->Tt, job->Tb, job->eps) != 0)
+		{
+			heat2dDestroy(h);
+			h = NULL;
+		}
+		if (h != NULL && heat2dRun(h) >= 0)
+		{
+			job->iterations = heat2dIterations(h);
+			job->change = heat2dChange(h);
+			job->status = heat2dWrite(h, job->path);
+		}
+
+		pthread_mutex_lock(&b->lock);
+		if (job->status == 0)
+			fprintf(b->report, "  %6d  %5d x %-5d  %8d  %f  %s\n", job->line, job->M, job->N,
+					job->iterations, job->change, job->path);
+		else
+			fprintf(b->report, "  %6d  %5d x %-5d  failed, '%s' not written\n", job->line,
+					job->M, job->N, job->path);
+		fflush(b->report);
+		pthread_mutex_unlock(&b->lock);
+	}
+	heat2dDestroy(h);
+}
+
+/*
+ * Solve the count plates of jobs on threads workers, with the solver
+ * settings of opts, reporting each one on report as it completes
+ * Return: number of plates that failed, -1 if the workers could not be
+ *	started
+ */
+int batchRun(BatchJob *jobs, int count, int threads, const Options *opts, FILE *report)
+{
+	Batch b;
+	ThreadPool *pool;
+	int failed = 0;
+	int k;
+
+	b.jobs = jobs;
+	b.opts = opts;
+	b.report = report;
+	b.order = malloc((count > 0 ? count : 1) * sizeof(int));
+	if (b.order == NULL || taskQueueInit(&b.queue, threads, count) != 0)
+	{
+		free(b.order);
+		return -1;
+	}
+	for (k = 0; k < count; k++)
+		b.order[k] = k;
+	sortJobs = jobs;
+	qsort(b.order, count, sizeof(int), compareJobs);
+	pthread_mutex_init(&b.lock, NULL);
+
+	pool = poolCreate(threads);
+	if (pool == NULL)
+	{
+		fprintf(stderr, "heat2d: cannot start %d threads\n", threads);
+		failed = -1;
+	}
+	else if (opts->affinity != NULL)
+	{
+		int *cpus = malloc(threads * sizeof(int));
+		if (cpus == NULL || affinityCpus(opts->affinity, threads, cpus) != 0 ||
+				poolPin(pool, cpus) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot pin the threads with --affinity=%s\n",
+					opts->affinity);
+			failed = -1;
+		}
+		free(cpus);
+	}
+
+	if (failed == 0)
+	{
+		fprintf(report, "\n  %6s  %-13s  %8s  %-8s  %s\n", "Line", "Plate", "Iters",
+				"Change", "File");
+		poolRun(pool, solvePlates, &b);
+		for (k = 0; k < count; k++)
+			if (jobs[k].status != 0)
+				failed++;
+	}
+	if (pool != NULL)
+		poolDestroy(pool);
+	pthread_mutex_destroy(&b.lock);
+	taskQueueFree(&b.queue);
+	free(b.order);
+	return failed;
+}
@@ -0,0 +1,43 @@
+/*
+ *	Batch mode: many plates solved on one worker pool
+ *
+ *	A job list has one plate per line, with the positional arguments of
+ *	heat2d:
+ *
+ *		M N Tl Tr Tt Tb eps file
+ *
+ *	Blank lines are skipped and '#' starts a comment. Plates of a few
+ *	hundred points a side are solved faster by one thread than split over
+ *	several that meet at a barrier every sweep, so every worker solves whole
+ *	plates with the serial solvers, one after the other. The aim is plates
+ *	per second, not the latency of one plate.
+ *
+ *	The plates are handed out largest first through a TaskQueue, so the
+ *	small ones fill the gaps at the end. Plates of the same size are next to
+ *	each other in that order, and a worker keeps its Heat2d context (grid,
+ *	multigrid levels) from one to the next with heat2dReset(). Every result
+ *	is reported as soon as its file is written.
+ */
+#ifndef HEAT2D_BATCH_H
+#define HEAT2D_BATCH_H
+
+#include <stdio.h>
+#include "heat2d_options.h"
+
+typedef struct {
+	int M, N;
+	double Tl, Tr, Tt, Tb;
+	double eps;
+	char *path;			//solution file
+	int line;			//line of the job list
+	//Filled in by batchRun()
+	int iterations;
+	double change;
+	int status;			//0, -1 if the plate could not be solved or written
+} BatchJob;
+
+int batchRead(const char *path, BatchJob **jobs);
+int batchRun(BatchJob *jobs, int count, int threads, const Options *opts, FILE *report);
+void batchFree(BatchJob *jobs, int count);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ *	Convergence checking policy
+ */
+#include <math.h>
+#include <limits.h>
+#include "heat2d_converge.h"
+
+void checkPolicyDefault(CheckPolicy *policy)
+{
+	policy->norm = CHECK_DELTA;
+	policy->every = 1;
+	policy->limit = 0;
+}
+
+/*
+ * Start a solve under policy (NULL = the default, a change test every sweep)
+ */
+void convergeInit(Convergence *c, const CheckPolicy *policy)
+{
+	if (policy != NULL)
+		c->policy = *policy;
+	else
+		checkPolicyDefault(&c->policy);
+	c->interval = (c->policy.every > 0) ? c->policy.every : 1;
+	c->next = c->interval;
+	c->lastIter = -1;
+	c->last = 0.0;
+	c->stop = (c->policy.limit > 0) ? c->policy.limit : INT_MAX;
+}
+
+/*
+ * Continue a solve that has already run iterations (resumed from a
+ * checkpoint)
+ */
+void convergeResume(Convergence *c, int iterations)
+{
+	c->next = iterations + c->interval;
+	if (c->policy.limit > 0)
+		c->stop = iterations + c->policy.limit;
+}
+
+/*
+ * Whether the solver step that takes the iteration count from iterations
+ * to iterations + step ends with a check
+ */
+int convergeDue(const Convergence *c, int iterations, int step)
+{
+	return iterations + step >= c->next || iterations + step >= c->stop;
+}
+
+/*
+ * Whether the iteration limit has been reached
+ */
+int convergeStopped(const Convergence *c, int iterations)
+{
+	return iterations >= c->stop;
+}
+
+/*
+ * Record the measure of the check made at iterations and schedule the next
+ */
+void convergeUpdate(Convergence *c, int iterations, double value, double eps)
+{
+	if (c->policy.every == 0 && c->lastIter >= 0 && value > eps &&
+			value < c->last && value > 0.0)
+	{
+		//Measure falls like rate^sweeps: aim halfway to the predicted crossing
+		double rate = log(value / c->last) / (iterations - c->lastIter);
+		double remaining = log(eps / value) / rate;
+		int interval = (int) (remaining / 2.0);
+
+		if (interval > 2 * c->interval)
+			interval = 2 * c->interval;
+		if (interval > CHECK_MAX_INTERVAL)
+			interval = CHECK_MAX_INTERVAL;
+		c->interval = (interval < 1) ? 1 : interval;
+	}
+	else if (c->policy.every == 0)
+		c->interval = 1;
+	c->lastIter = iterations;
+	c->last = value;
+	c->next = iterations + c->interval;
+}
+
+/*
+ * Residual of rows first..last of u: rowNorm[i] is the largest |r| of row i
+ * (CHECK_LINF) or the sum of its r^2 (CHECK_L2)
+ */
+void heat2dResidualRows(const Grid *u, int first, int last, int norm, double *rowNorm)
+{
+	int N = u->N;
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		const double *row = GRID_ROW(u, i);
+		const double *north = GRID_ROW(u, i - 1);
+		const double *south = GRID_ROW(u, i + 1);
+		double acc = 0.0;
+
+		for (j = 1; j < N - 1; j++)
+		{
+			double r = (north[j] + south[j] + row[j-1] + row[j+1]) / 4.0 - row[j];
+			if (norm == CHECK_L2)
+				acc += r * r;
+			else
+			{
+				r = fabs(r);
+				acc = (r > acc) ? r : acc;
+			}
+		}
+		rowNorm[i] = acc;
+	}
+}
+
+/*
+ * Combine the rows 1..M-2 of rowNorm into the norm of the whole plate. The
+ * rows are always added in the same order, so the result does not depend on
+ * how the rows were split between threads.
+ */
+double heat2dResidualNorm(const Grid *u, int norm, const double *rowNorm)
+{
+	double acc = 0.0;
+	int i;
+
+	for (i = 1; i < u->M - 1; i++)
+	{
+		if (norm == CHECK_L2)
+			acc += rowNorm[i];
+		else
+			acc = (rowNorm[i] > acc) ? rowNorm[i] : acc;
+	}
+	if (norm == CHECK_L2 && u->M > 2 && u->N > 2)
+		acc = sqrt(acc / ((double) (u->M - 2) * (u->N - 2)));
+	return acc;
+}
@@ -0,0 +1,69 @@
+/*
+ *	Convergence checking policy
+ *
+ *	Measuring convergence costs more than the sweep itself needs: the kernel
+ *	has to track the change of every point, and the threads have to combine
+ *	their maxima. A policy says how often that is done and what is measured:
+ *
+ *	every - sweeps between checks; the sweeps in between use the update-only
+ *		kernels. 0 makes the interval adaptive: after each check the rate at
+ *		which the measure falls is estimated from the previous check, and the
+ *		next check is placed halfway to where the measure is predicted to
+ *		cross eps (at most twice the previous interval). Far from the answer
+ *		the checks get rare, close to it they come every sweep again.
+ *	norm - CHECK_DELTA is the largest change made by the checked sweep (the
+ *		original test). CHECK_LINF and CHECK_L2 measure the residual of the
+ *		discrete Laplace equation after the sweep,
+ *			r(i,j) = (u(i-1,j) + u(i+1,j) + u(i,j-1) + u(i,j+1)) / 4 - u(i,j)
+ *		as its largest |r| or its root mean square over the interior. r is
+ *		the change the next Jacobi sweep would make, so an Linf residual
+ *		below eps is at least as strict as the change test.
+ *
+ *	limit - stop after this many iterations even if eps is not reached
+ *		(0 = no limit); the last iteration is always checked, so the
+ *		measure at the stop is known. This is how a solve is advanced a
+ *		given number of sweeps at a time (heat2dStep in libheat2d.h).
+ *
+ *	Iteration stops at the first check whose measure is below eps, so the
+ *	answer always satisfies the tolerance for the chosen measure; checking
+ *	less often can only run a few sweeps past the point where it was first
+ *	satisfied.
+ */
+#ifndef HEAT2D_CONVERGE_H
+#define HEAT2D_CONVERGE_H
+
+#include "grid.h"
+
+#define CHECK_DELTA 0
+#define CHECK_LINF 1
+#define CHECK_L2 2
+
+//Longest adaptive interval, in sweeps
+#define CHECK_MAX_INTERVAL 256
+
+typedef struct {
+	int norm;		//CHECK_DELTA, CHECK_LINF or CHECK_L2
+	int every;		//sweeps between checks, 0 = adaptive
+	int limit;		//iterations before giving up on eps, 0 = no limit
+} CheckPolicy;
+
+typedef struct {
+	CheckPolicy policy;
+	int interval;	//sweeps between the last check and the next
+	int next;		//iteration count at which the next check is due
+	int lastIter;	//iteration count of the previous check, -1 before it
+	double last;	//measure at the previous check
+	int stop;		//iteration count at which the limit is reached
+} Convergence;
+
+void checkPolicyDefault(CheckPolicy *policy);
+void convergeInit(Convergence *c, const CheckPolicy *policy);
+void convergeResume(Convergence *c, int iterations);
+int convergeDue(const Convergence *c, int iterations, int step);
+int convergeStopped(const Convergence *c, int iterations);
+void convergeUpdate(Convergence *c, int iterations, double value, double eps);
+
+void heat2dResidualRows(const Grid *u, int first, int last, int norm, double *rowNorm);
+double heat2dResidualNorm(const Grid *u, int norm, const double *rowNorm);
+
+#endif
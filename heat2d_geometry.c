@@ -0,0 +1,274 @@
+/*
+ *	Plate geometry: fixed-temperature regions, heat sources and cutouts
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "heat2d_geometry.h"
+
+#define GEO_LINE 1024
+
+/*
+ * Rows and columns of the plate that f can cover
+ * Return: 0, -1 if it lies outside the plate
+ */
+static int featureBounds(const GeoFeature *f, int M, int N, int *i0, int *i1, int *j0,
+		int *j1)
+{
+	if (f->disk)
+	{
+		*i0 = (int) ceil(f->a - f->c);
+		*i1 = (int) floor(f->a + f->c);
+		*j0 = (int) ceil(f->b - f->c);
+		*j1 = (int) floor(f->b + f->c);
+	}
+	else
+	{
+		*i0 = (int) f->a;
+		*j0 = (int) f->b;
+		*i1 = (int) f->c;
+		*j1 = (int) f->d;
+	}
+	*i0 = (*i0 < 0) ? 0 : *i0;
+	*j0 = (*j0 < 0) ? 0 : *j0;
+	*i1 = (*i1 > M - 1) ? M - 1 : *i1;
+	*j1 = (*j1 > N - 1) ? N - 1 : *j1;
+	return (*i0 <= *i1 && *j0 <= *j1) ? 0 : -1;
+}
+
+/* Whether point (i, j), inside the bounds of f, is covered by it */
+static int featureCovers(const GeoFeature *f, int i, int j)
+{
+	double di = i - f->a, dj = j - f->b;
+	return !f->disk || di * di + dj * dj <= f->c * f->c;
+}
+
+/*
+ * Parse one feature line (comment already removed)
+ * Return: 1 for a feature, 0 for a blank line, -1 if it is not a feature
+ */
+static int parseFeature(const char *buf, GeoFeature *f)
+{
+	char kind[16], shape[16];
+	int used = 0, n;
+
+	if (strspn(buf, " \t\r\n") == strlen(buf))
+		return 0;
+	if (sscanf(buf, "%15s %15s %n", kind, shape, &used) != 2)
+		return -1;
+	buf += used;
+	if (strcmp(kind, "fixed") == 0)
+		f->kind = GEO_FIXED;
+	else if (strcmp(kind, "source") == 0)
+		f->kind = GEO_SOURCE;
+	else if (strcmp(kind, "cutout") == 0)
+		f->kind = GEO_CUTOUT;
+	else
+		return -1;
+	f->value = 0.0;
+	f->d = 0.0;
+	used = 0;
+	if (strcmp(shape, "rect") == 0)
+	{
+		f->disk = 0;
+		n = (f->kind == GEO_CUTOUT) ?
+			sscanf(buf, "%lf %lf %lf %lf %n", &f->a, &f->b, &f->c, &f->d, &used) + 1 :
+			sscanf(buf, "%lf %lf %lf %lf %lf %n", &f->a, &f->b, &f->c, &f->d, &f->value, &used);
+		if (n != 5)
+			return -1;
+	}
+	else if (strcmp(shape, "disk") == 0)
+	{
+		f->disk = 1;
+		n = (f->kind == GEO_CUTOUT) ?
+			sscanf(buf, "%lf %lf %lf %n", &f->a, &f->b, &f->c, &used) + 1 :
+			sscanf(buf, "%lf %lf %lf %lf %n", &f->a, &f->b, &f->c, &f->value, &used);
+		if (n != 4 || f->c < 0)
+			return -1;
+	}
+	else
+		return -1;
+	return (buf[used] == '\0') ? 1 : -1;
+}
+
+/*
+ * Class bytes and sources of the M x N plate from the features of g
+ * Return: 0, -1 if out of memory
+ */
+static int geometryRaster(Geometry *g)
+{
+	int M = g->M, N = g->N;
+	unsigned char *kind = calloc((size_t) M * N, 1);	/* GEO_ kind of every point, 0 = plain */
+	int hasSource = 0;
+	int k, i, j;
+
+	if (kind == NULL)
+		return -1;
+	for (k = 0; k < g->features; k++)
+		hasSource |= (g->feature[k].kind == GEO_SOURCE);
+	if (hasSource)
+	{
+		if (gridAlloc(&g->source, M, N) != 0)
+		{
+			free(kind);
+			return -1;
+		}
+		memset(g->source.data, 0, (size_t) M * g->source.stride * sizeof(double));
+	}
+
+	for (k = 0; k < g->features; k++)
+	{
+		const GeoFeature *f = &g->feature[k];
+		int i0, i1, j0, j1;
+
+		if (featureBounds(f, M, N, &i0, &i1, &j0, &j1) != 0)
+			continue;
+		for (i = i0; i <= i1; i++)
+			for (j = j0; j <= j1; j++)
+				if (featureCovers(f, i, j))
+				{
+					kind[(size_t) i * N + j] = f->kind;
+					if (hasSource)
+						GRID_ROW(&g->source, i)[j] = (f->kind == GEO_SOURCE) ? f->value : 0.0;
+				}
+	}
+
+	for (i = 0; i < M; i++)
+	{
+		const unsigned char *row = kind + (size_t) i * N;
+		unsigned char *cls = GEO_CLASS(g, i);
+		int plain = (i > 0 && i < M - 1);
+		for (j = 0; j < N; j++)
+		{
+			g->fixed += (row[j] == GEO_FIXED);
+			g->sources += (row[j] == GEO_SOURCE);
+			g->cutout += (row[j] == GEO_CUTOUT);
+			if (i == 0 || i == M - 1 || j == 0 || j == N - 1 ||
+					row[j] == GEO_FIXED || row[j] == GEO_CUTOUT)
+			{
+				cls[j] = CELL_FIXED;
+				continue;
+			}
+			cls[j] = 0;
+			if (row[j - N] != GEO_CUTOUT)
+				cls[j] |= CELL_NORTH;
+			if (row[j + N] != GEO_CUTOUT)
+				cls[j] |= CELL_SOUTH;
+			if (row[j - 1] != GEO_CUTOUT)
+				cls[j] |= CELL_WEST;
+			if (row[j + 1] != GEO_CUTOUT)
+				cls[j] |= CELL_EAST;
+		}
+		for (j = 1; j < N - 1; j++)
+			plain &= (cls[j] == CELL_OPEN && row[j] != GEO_SOURCE);
+		g->plain[i] = plain;
+	}
+	free(kind);
+	return 0;
+}
+
+/*
+ * Read the features at path and lay them out on an M x N plate
+ * Return: 0, -1 if the file cannot be read, a line is not a feature
+ *	(reported on stderr) or memory runs out
+ */
+int geometryRead(Geometry *g, const char *path, int M, int N)
+{
+	FILE *fp = fopen(path, "r");
+	char buf[GEO_LINE];
+	int size = 0, line = 0;
+
+	memset(g, 0, sizeof(*g));
+	g->M = M;
+	g->N = N;
+	if (fp == NULL)
+	{
+		fprintf(stderr, "heat2d: cannot open the geometry '%s'\n", path);
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		GeoFeature f;
+		char *comment = strchr(buf, '#');
+		int r;
+
+		line++;
+		if (comment != NULL)
+			*comment = '\0';
+		r = parseFeature(buf, &f);
+		if (r == 0)
+			continue;
+		if (r < 0)
+		{
+			fprintf(stderr, "heat2d: %s:%d: expected 'fixed|source rect I0 J0 I1 J1 V',\n"
+					"'fixed|source disk I J R V', 'cutout rect I0 J0 I1 J1' or"
+					" 'cutout disk I J R'\n", path, line);
+			fclose(fp);
+			geometryFree(g);
+			return -1;
+		}
+		if (g->features == size)
+		{
+			GeoFeature *grown;
+			size = (size > 0) ? 2 * size : 16;
+			grown = realloc(g->feature, size * sizeof(GeoFeature));
+			if (grown == NULL)
+			{
+				fclose(fp);
+				geometryFree(g);
+				return -1;
+			}
+			g->feature = grown;
+		}
+		g->feature[g->features++] = f;
+	}
+	fclose(fp);
+
+	//Class rows are padded so that a vector kernel can read 8 bytes from any point
+	g->stride = (N + 8 + GRID_ALIGN - 1) / GRID_ALIGN * GRID_ALIGN;
+	g->cls = calloc((size_t) M * g->stride, 1);
+	g->plain = calloc(M, 1);
+	g->zero = calloc(N, sizeof(double));
+	if (g->cls == NULL || g->plain == NULL || g->zero == NULL || geometryRaster(g) != 0)
+	{
+		geometryFree(g);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Set the fixed points of u to their temperatures and the cutouts to 0,
+ * after the boundary and the initial guess
+ */
+void geometryApply(const Geometry *g, Grid *u)
+{
+	int k, i, j;
+
+	for (k = 0; k < g->features; k++)
+	{
+		const GeoFeature *f = &g->feature[k];
+		int i0, i1, j0, j1;
+
+		if (f->kind == GEO_SOURCE || featureBounds(f, u->M, u->N, &i0, &i1, &j0, &j1) != 0)
+			continue;
+		for (i = i0; i <= i1; i++)
+			for (j = j0; j <= j1; j++)
+				if (featureCovers(f, i, j))
+					GRID_ROW(u, i)[j] = (f->kind == GEO_FIXED) ? f->value : 0.0;
+	}
+}
+
+void geometryFree(Geometry *g)
+{
+	gridFree(&g->source);
+	free(g->cls);
+	free(g->plain);
+	free(g->zero);
+	free(g->feature);
+	g->cls = NULL;
+	g->plain = NULL;
+	g->zero = NULL;
+	g->feature = NULL;
+}
@@ -0,0 +1,74 @@
+/*
+ *	Plate geometry: fixed-temperature regions, heat sources and cutouts
+ *	inside the plate (--geometry=FILE)
+ *
+ *	The file lists features, one per line, in plate points (row i from 0 to
+ *	M-1, column j from 0 to N-1):
+ *
+ *		fixed  rect I0 J0 I1 J1  T	points held at temperature T (bolts,
+ *		fixed  disk I J R        T	heaters at a set temperature)
+ *		source rect I0 J0 I1 J1  Q	points that gain Q per sweep: they settle
+ *		source disk I J R        Q	Q / 4 above the mean of their neighbours
+ *		cutout rect I0 J0 I1 J1		points that are not part of the plate;
+ *		cutout disk I J R			their edges are insulated
+ *
+ *	A rect covers rows I0..I1 and columns J0..J1, a disk the points within
+ *	R of (I, J). Blank lines are skipped and '#' starts a comment. Where
+ *	features overlap the later one wins. Features may also cover the edges
+ *	of the plate, replacing the edge temperature there.
+ *
+ *	Every point gets a class byte: which of its four neighbours are part of
+ *	the plate (a neighbour in a cutout is replaced by the point itself, so
+ *	no heat flows across the edge of a cutout), and whether the point keeps
+ *	its value (fixed points and cutouts). The masked row kernels turn those
+ *	bits into vector blends, so a sweep costs the same wherever the
+ *	features are; rows that no feature touches keep the plain kernels.
+ *	Cutout points are written as 0. A part of the plate that
+ *	cutouts separate from every fixed point and edge has no steady state.
+ */
+#ifndef HEAT2D_GEOMETRY_H
+#define HEAT2D_GEOMETRY_H
+
+#include "grid.h"
+
+//Bits of a class byte
+#define CELL_NORTH 0x01		//neighbour i-1 is part of the plate
+#define CELL_SOUTH 0x02		//neighbour i+1
+#define CELL_WEST 0x04		//neighbour j-1
+#define CELL_EAST 0x08		//neighbour j+1
+#define CELL_FIXED 0x10		//the point keeps its value
+#define CELL_OPEN (CELL_NORTH | CELL_SOUTH | CELL_WEST | CELL_EAST)
+
+#define GEO_FIXED 1
+#define GEO_SOURCE 2
+#define GEO_CUTOUT 3
+
+typedef struct {
+	int kind;				//GEO_FIXED, GEO_SOURCE or GEO_CUTOUT
+	int disk;				//disk (I, J, R) rather than rect (I0, J0, I1, J1)
+	double a, b, c, d;		//I0 J0 I1 J1 or I J R
+	double value;			//T or Q
+} GeoFeature;
+
+typedef struct {
+	int M, N;
+	int stride;				//bytes per row of cls
+	unsigned char *cls;		//class byte of every point
+	unsigned char *plain;	//rows whose interior is all open and without sources
+	Grid source;			//Q of every point, no data if there are no sources
+	double *zero;			//N zeros: the source row of a plate without sources
+	GeoFeature *feature;
+	int features;
+	long fixed, sources, cutout;	//points of each kind
+} Geometry;
+
+/* Class bytes of row i (readable up to 8 bytes past column N-1) */
+#define GEO_CLASS(g, i) ((g)->cls + (size_t) (i) * (g)->stride)
+/* Sources of row i */
+#define GEO_SOURCE_ROW(g, i) ((g)->source.data != NULL ? GRID_ROW(&(g)->source, i) : (g)->zero)
+
+int geometryRead(Geometry *g, const char *path, int M, int N);
+void geometryApply(const Geometry *g, Grid *u);
+void geometryFree(Geometry *g);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ *	Initial guesses for the plate interior
+ */
+#include <stdio.h>
+#include <string.h>
+#include "heat2d_init.h"
+#include "heat2d_solver.h"
+
+/*
+ * Cascadic start: replace the interior of u by the interpolated solution
+ * of a coarser plate with the same boundary
+ */
+void heat2dCascade(Grid *u, double eps)
+{
+	Grid coarse;
+	double tol;
+	int Mc = (u->M + 1) / 2, Nc = (u->N + 1) / 2;
+
+	if (u->M <= INIT_COARSEST && u->N <= INIT_COARSEST)
+		return;
+	if (Mc < 3 || Nc < 3 || gridAlloc(&coarse, Mc, Nc) != 0)
+		return;
+	//Boundary sampled along the edges, interior as a start for its own solve
+	gridResample(&coarse, u, 0);
+	heat2dCascade(&coarse, eps);
+	heat2dSolveSOR(&coarse, eps, heat2dOptimalOmega(Mc, Nc), NULL, 0, &tol);
+	gridResample(u, &coarse, 1);
+	gridFree(&coarse);
+}
+
+/*
+ * Set the interior of u (boundary already initialised) from init, see
+ * heat2d_init.h
+ * Return: 0 on success, -1 if init names a file that can't be read
+ */
+int heat2dInitialGuess(Grid *u, const char *init, double eps)
+{
+	Grid prior;
+
+	if (init == NULL || strcmp(init, "mean") == 0)
+		return 0;
+	if (strcmp(init, "cascade") == 0)
+	{
+		heat2dCascade(u, eps);
+		return 0;
+	}
+	if (gridLoad(init, &prior) != 0)
+		return -1;
+	gridResample(u, &prior, 1);
+	gridFree(&prior);
+	return 0;
+}
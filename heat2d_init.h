@@ -0,0 +1,29 @@
+/*
+ *	Initial guesses for the plate interior
+ *
+ *	initialize_plate() sets the boundary and fills the interior with the
+ *	mean boundary temperature, which leaves every smooth component of the
+ *	error to the solver. heat2dInitialGuess() can replace that interior:
+ *
+ *	"mean"    - keep it (the default)
+ *	"cascade" - solve the plate on a grid with half the points in each
+ *		direction (itself started the same way, down to INIT_COARSEST
+ *		points) and interpolate that solution up. The coarse solves use
+ *		red-black SOR to the same eps and cost a fraction of the fine one.
+ *	a file    - a previous solution (binary or text) of any resolution,
+ *		resampled bilinearly. Only its interior is used, the boundary is
+ *		the one of this plate, so a plate with slightly different
+ *		temperatures starts from its neighbour's answer.
+ */
+#ifndef HEAT2D_INIT_H
+#define HEAT2D_INIT_H
+
+#include "grid.h"
+
+//Size below which the cascade solves directly
+#define INIT_COARSEST 33
+
+int heat2dInitialGuess(Grid *u, const char *init, double eps);
+void heat2dCascade(Grid *u, double eps);
+
+#endif
@@ -0,0 +1,585 @@
+/*
+ *	Stencil row kernels: portable scalar version plus AVX2 and AVX-512
+ *	versions picked at run time from what the CPU supports.
+ */
+#include <string.h>
+#include <math.h>
+#include "heat2d_kernel.h"
+#include "heat2d_geometry.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+static double rowKernelScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N);
+static void rowUpdateScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N);
+
+static double rowKernelMaskedScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N);
+static void rowUpdateMaskedScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N);
+
+static float rowKernelScalarF(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N);
+static void rowUpdateScalarF(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N);
+
+RowKernel heat2dRowKernel = rowKernelScalar;
+RowUpdate heat2dRowUpdate = rowUpdateScalar;
+RowKernelMasked heat2dRowKernelMasked = rowKernelMaskedScalar;
+RowUpdateMasked heat2dRowUpdateMasked = rowUpdateMaskedScalar;
+RowKernelF heat2dRowKernelF = rowKernelScalarF;
+RowUpdateF heat2dRowUpdateF = rowUpdateScalarF;
+static const char *kernelName = "scalar";
+
+/*
+ * Portable version. The max is written without a branch so the compiler is
+ * free to vectorize it for whatever target it was built for.
+ */
+static double rowKernelScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	int j;
+	double diff = 0.0;
+	for ( j = 1; j < N - 1; j++ )
+	{
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0;
+
+		double delta = fabs(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+static void rowUpdateScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	int j;
+	for ( j = 1; j < N - 1; j++ )
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0;
+}
+
+/*
+ * New value of point j of a row with geometry. The selects compile to
+ * conditional moves or blends; the vector kernels do the same with masks.
+ */
+static inline double maskedPoint(const double *restrict north, const double *restrict south,
+		const double *restrict curr, const unsigned char *restrict cls,
+		const double *restrict source, int j)
+{
+	unsigned c = cls[j];
+	double n = (c & CELL_NORTH) ? north[j] : curr[j];
+	double s = (c & CELL_SOUTH) ? south[j] : curr[j];
+	double w = (c & CELL_WEST) ? curr[j-1] : curr[j];
+	double e = (c & CELL_EAST) ? curr[j+1] : curr[j];
+	double v = (n + s + w + e + source[j]) / 4.0;
+	return (c & CELL_FIXED) ? curr[j] : v;
+}
+
+static double rowKernelMaskedScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	int j;
+	double diff = 0.0;
+	for ( j = 1; j < N - 1; j++ )
+	{
+		out[j] = maskedPoint(north, south, curr, cls, source, j);
+
+		double delta = fabs(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+static void rowUpdateMaskedScalar(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	int j;
+	for ( j = 1; j < N - 1; j++ )
+		out[j] = maskedPoint(north, south, curr, cls, source, j);
+}
+
+static float rowKernelScalarF(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	int j;
+	float diff = 0.0f;
+	for ( j = 1; j < N - 1; j++ )
+	{
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0f;
+
+		float delta = fabsf(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+static void rowUpdateScalarF(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	int j;
+	for ( j = 1; j < N - 1; j++ )
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0f;
+}
+
+/*
+ * Red-black over-relaxation of one row, in place. Only every other point,
+ * starting at first (1 or 2), is updated; its east and west neighbours are
+ * of the other colour and are not touched by this pass, so the row can be
+ * both read and written without a saved copy.
+ *		row[j] += omega * ((north[j] + south[j] + row[j-1] + row[j+1]) / 4 - row[j])
+ *	Return: the largest |change| of the updated points
+ */
+double heat2dRowKernelRB(double *restrict row, const double *restrict north,
+		const double *restrict south, int first, int N, double omega)
+{
+	int j;
+	double diff = 0.0;
+	for ( j = first; j < N - 1; j += 2 )
+	{
+		double old = row[j];
+		double delta = omega * ((north[j] + south[j] + row[j-1] + row[j+1]) / 4.0 - old);
+		row[j] = old + delta;
+
+		delta = fabs(delta);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+/*
+ * heat2dRowKernelRB without the change
+ */
+void heat2dRowUpdateRB(double *restrict row, const double *restrict north,
+		const double *restrict south, int first, int N, double omega)
+{
+	int j;
+	for ( j = first; j < N - 1; j += 2 )
+	{
+		double old = row[j];
+		row[j] = old + omega * ((north[j] + south[j] + row[j-1] + row[j+1]) / 4.0 - old);
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * 4 points per step. The tail that does not fill a vector is finished by
+ * the scalar loop.
+ */
+__attribute__((target("avx2")))
+static double rowKernelAVX2(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	__m256d vdiff = _mm256_setzero_pd();
+	double diff, lanes[4];
+	int j;
+
+	for ( j = 1; j + 4 <= N - 1; j += 4 )
+	{
+		__m256d c = _mm256_loadu_pd(curr + j);
+		__m256d s = _mm256_add_pd(_mm256_loadu_pd(north + j), _mm256_loadu_pd(south + j));
+		s = _mm256_add_pd(s, _mm256_loadu_pd(curr + j - 1));
+		s = _mm256_add_pd(s, _mm256_loadu_pd(curr + j + 1));
+		s = _mm256_mul_pd(s, quarter);
+		_mm256_storeu_pd(out + j, s);
+		vdiff = _mm256_max_pd(vdiff, _mm256_and_pd(_mm256_sub_pd(c, s), absMask));
+	}
+	_mm256_storeu_pd(lanes, vdiff);
+	diff = lanes[0];
+	diff = (lanes[1] > diff) ? lanes[1] : diff;
+	diff = (lanes[2] > diff) ? lanes[2] : diff;
+	diff = (lanes[3] > diff) ? lanes[3] : diff;
+
+	for ( ; j < N - 1; j++ )
+	{
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0;
+
+		double delta = fabs(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+__attribute__((target("avx2")))
+static void rowUpdateAVX2(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	int j;
+
+	for ( j = 1; j + 4 <= N - 1; j += 4 )
+	{
+		__m256d s = _mm256_add_pd(_mm256_loadu_pd(north + j), _mm256_loadu_pd(south + j));
+		s = _mm256_add_pd(s, _mm256_loadu_pd(curr + j - 1));
+		s = _mm256_add_pd(s, _mm256_loadu_pd(curr + j + 1));
+		_mm256_storeu_pd(out + j, _mm256_mul_pd(s, quarter));
+	}
+	for ( ; j < N - 1; j++ )
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0;
+}
+
+/*
+ * Blend mask of the 4 class bytes in c for one CELL_ bit: the bit is moved
+ * to the sign of its lane, the only bit blendv looks at
+ */
+__attribute__((target("avx2")))
+static inline __m256d classMaskAVX2(__m256i c, unsigned bit)
+{
+	return _mm256_castsi256_pd(_mm256_slli_epi64(c, 63 - __builtin_ctz(bit)));
+}
+
+/*
+ * 4 points of a row with geometry: the class bytes are widened to one
+ * 64-bit lane per point and every select becomes a blend
+ */
+__attribute__((target("avx2")))
+static inline __m256d maskedAVX2(const double *restrict north, const double *restrict south,
+		const double *restrict curr, const unsigned char *restrict cls,
+		const double *restrict source, int j, __m256d c)
+{
+	const __m256d quarter = _mm256_set1_pd(0.25);
+	int bytes;
+	__m256i k;
+	__m256d s;
+
+	memcpy(&bytes, cls + j, sizeof(bytes));
+	k = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes));
+	s = _mm256_add_pd(_mm256_blendv_pd(c, _mm256_loadu_pd(north + j), classMaskAVX2(k, CELL_NORTH)),
+			_mm256_blendv_pd(c, _mm256_loadu_pd(south + j), classMaskAVX2(k, CELL_SOUTH)));
+	s = _mm256_add_pd(s, _mm256_blendv_pd(c, _mm256_loadu_pd(curr + j - 1), classMaskAVX2(k, CELL_WEST)));
+	s = _mm256_add_pd(s, _mm256_blendv_pd(c, _mm256_loadu_pd(curr + j + 1), classMaskAVX2(k, CELL_EAST)));
+	s = _mm256_mul_pd(_mm256_add_pd(s, _mm256_loadu_pd(source + j)), quarter);
+	return _mm256_blendv_pd(s, c, classMaskAVX2(k, CELL_FIXED));
+}
+
+__attribute__((target("avx2")))
+static double rowKernelMaskedAVX2(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	__m256d vdiff = _mm256_setzero_pd();
+	double diff, lanes[4];
+	int j;
+
+	for ( j = 1; j + 4 <= N - 1; j += 4 )
+	{
+		__m256d c = _mm256_loadu_pd(curr + j);
+		__m256d s = maskedAVX2(north, south, curr, cls, source, j, c);
+		_mm256_storeu_pd(out + j, s);
+		vdiff = _mm256_max_pd(vdiff, _mm256_and_pd(_mm256_sub_pd(c, s), absMask));
+	}
+	_mm256_storeu_pd(lanes, vdiff);
+	diff = lanes[0];
+	diff = (lanes[1] > diff) ? lanes[1] : diff;
+	diff = (lanes[2] > diff) ? lanes[2] : diff;
+	diff = (lanes[3] > diff) ? lanes[3] : diff;
+
+	for ( ; j < N - 1; j++ )
+	{
+		out[j] = maskedPoint(north, south, curr, cls, source, j);
+
+		double delta = fabs(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+__attribute__((target("avx2")))
+static void rowUpdateMaskedAVX2(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	int j;
+
+	for ( j = 1; j + 4 <= N - 1; j += 4 )
+		_mm256_storeu_pd(out + j, maskedAVX2(north, south, curr, cls, source, j,
+					_mm256_loadu_pd(curr + j)));
+	for ( ; j < N - 1; j++ )
+		out[j] = maskedPoint(north, south, curr, cls, source, j);
+}
+
+__attribute__((target("avx2")))
+static float rowKernelAVX2F(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 vdiff = _mm256_setzero_ps();
+	float diff, lanes[8];
+	int j, k;
+
+	for ( j = 1; j + 8 <= N - 1; j += 8 )
+	{
+		__m256 c = _mm256_loadu_ps(curr + j);
+		__m256 s = _mm256_add_ps(_mm256_loadu_ps(north + j), _mm256_loadu_ps(south + j));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j - 1));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j + 1));
+		s = _mm256_mul_ps(s, quarter);
+		_mm256_storeu_ps(out + j, s);
+		vdiff = _mm256_max_ps(vdiff, _mm256_and_ps(_mm256_sub_ps(c, s), absMask));
+	}
+	_mm256_storeu_ps(lanes, vdiff);
+	diff = lanes[0];
+	for ( k = 1; k < 8; k++ )
+		diff = (lanes[k] > diff) ? lanes[k] : diff;
+
+	for ( ; j < N - 1; j++ )
+	{
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0f;
+
+		float delta = fabsf(curr[j] - out[j]);
+		diff = (delta > diff) ? delta : diff;
+	}
+	return diff;
+}
+
+__attribute__((target("avx2")))
+static void rowUpdateAVX2F(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	int j;
+
+	for ( j = 1; j + 8 <= N - 1; j += 8 )
+	{
+		__m256 s = _mm256_add_ps(_mm256_loadu_ps(north + j), _mm256_loadu_ps(south + j));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j - 1));
+		s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j + 1));
+		_mm256_storeu_ps(out + j, _mm256_mul_ps(s, quarter));
+	}
+	for ( ; j < N - 1; j++ )
+		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1] ) / 4.0f;
+}
+
+/*
+ * 8 points per step, the tail is handled with a masked load/store instead
+ * of a scalar loop.
+ */
+__attribute__((target("avx512f")))
+static double rowKernelAVX512(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	__m512d vdiff = _mm512_setzero_pd();
+	int j;
+
+	for ( j = 1; j < N - 1; j += 8 )
+	{
+		int left = N - 1 - j;
+		__mmask8 m = (left >= 8) ? 0xff : (__mmask8) ((1u << left) - 1);
+		__m512d c = _mm512_maskz_loadu_pd(m, curr + j);
+		__m512d s = _mm512_add_pd(_mm512_maskz_loadu_pd(m, north + j),
+				_mm512_maskz_loadu_pd(m, south + j));
+		s = _mm512_add_pd(s, _mm512_maskz_loadu_pd(m, curr + j - 1));
+		s = _mm512_add_pd(s, _mm512_maskz_loadu_pd(m, curr + j + 1));
+		s = _mm512_mul_pd(s, quarter);
+		_mm512_mask_storeu_pd(out + j, m, s);
+		vdiff = _mm512_max_pd(vdiff, _mm512_abs_pd(_mm512_sub_pd(c, s)));
+	}
+	return _mm512_reduce_max_pd(vdiff);
+}
+
+__attribute__((target("avx512f")))
+static void rowUpdateAVX512(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N)
+{
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	int j;
+
+	for ( j = 1; j < N - 1; j += 8 )
+	{
+		int left = N - 1 - j;
+		__mmask8 m = (left >= 8) ? 0xff : (__mmask8) ((1u << left) - 1);
+		__m512d s = _mm512_add_pd(_mm512_maskz_loadu_pd(m, north + j),
+				_mm512_maskz_loadu_pd(m, south + j));
+		s = _mm512_add_pd(s, _mm512_maskz_loadu_pd(m, curr + j - 1));
+		s = _mm512_add_pd(s, _mm512_maskz_loadu_pd(m, curr + j + 1));
+		_mm512_mask_storeu_pd(out + j, m, _mm512_mul_pd(s, quarter));
+	}
+}
+
+/*
+ * 8 points of a row with geometry (m = the points of the row that are
+ * left): the class bytes are widened to 64-bit lanes and tested into mask
+ * registers, and every select is a masked blend
+ */
+__attribute__((target("avx512f")))
+static inline __m512d maskedAVX512(const double *restrict north, const double *restrict south,
+		const double *restrict curr, const unsigned char *restrict cls,
+		const double *restrict source, int j, __mmask8 m, __m512d c)
+{
+	const __m512d quarter = _mm512_set1_pd(0.25);
+	__m512i k = _mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i *) (cls + j)));
+	__m512d s;
+
+	s = _mm512_add_pd(
+			_mm512_mask_blend_pd(_mm512_test_epi64_mask(k, _mm512_set1_epi64(CELL_NORTH)), c,
+				_mm512_maskz_loadu_pd(m, north + j)),
+			_mm512_mask_blend_pd(_mm512_test_epi64_mask(k, _mm512_set1_epi64(CELL_SOUTH)), c,
+				_mm512_maskz_loadu_pd(m, south + j)));
+	s = _mm512_add_pd(s, _mm512_mask_blend_pd(_mm512_test_epi64_mask(k,
+					_mm512_set1_epi64(CELL_WEST)), c, _mm512_maskz_loadu_pd(m, curr + j - 1)));
+	s = _mm512_add_pd(s, _mm512_mask_blend_pd(_mm512_test_epi64_mask(k,
+					_mm512_set1_epi64(CELL_EAST)), c, _mm512_maskz_loadu_pd(m, curr + j + 1)));
+	s = _mm512_mul_pd(_mm512_add_pd(s, _mm512_maskz_loadu_pd(m, source + j)), quarter);
+	return _mm512_mask_blend_pd(_mm512_test_epi64_mask(k, _mm512_set1_epi64(CELL_FIXED)), s, c);
+}
+
+__attribute__((target("avx512f")))
+static double rowKernelMaskedAVX512(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	__m512d vdiff = _mm512_setzero_pd();
+	int j;
+
+	for ( j = 1; j < N - 1; j += 8 )
+	{
+		int left = N - 1 - j;
+		__mmask8 m = (left >= 8) ? 0xff : (__mmask8) ((1u << left) - 1);
+		__m512d c = _mm512_maskz_loadu_pd(m, curr + j);
+		__m512d s = maskedAVX512(north, south, curr, cls, source, j, m, c);
+		_mm512_mask_storeu_pd(out + j, m, s);
+		vdiff = _mm512_max_pd(vdiff, _mm512_abs_pd(_mm512_sub_pd(c, s)));
+	}
+	return _mm512_reduce_max_pd(vdiff);
+}
+
+__attribute__((target("avx512f")))
+static void rowUpdateMaskedAVX512(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N)
+{
+	int j;
+
+	for ( j = 1; j < N - 1; j += 8 )
+	{
+		int left = N - 1 - j;
+		__mmask8 m = (left >= 8) ? 0xff : (__mmask8) ((1u << left) - 1);
+		_mm512_mask_storeu_pd(out + j, m, maskedAVX512(north, south, curr, cls, source, j, m,
+					_mm512_maskz_loadu_pd(m, curr + j)));
+	}
+}
+
+/*
+ * 16 floats per step, masked tail
+ */
+__attribute__((target("avx512f")))
+static float rowKernelAVX512F(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	const __m512 quarter = _mm512_set1_ps(0.25f);
+	__m512 vdiff = _mm512_setzero_ps();
+	int j;
+
+	for ( j = 1; j < N - 1; j += 16 )
+	{
+		int left = N - 1 - j;
+		__mmask16 m = (left >= 16) ? 0xffff : (__mmask16) ((1u << left) - 1);
+		__m512 c = _mm512_maskz_loadu_ps(m, curr + j);
+		__m512 s = _mm512_add_ps(_mm512_maskz_loadu_ps(m, north + j),
+				_mm512_maskz_loadu_ps(m, south + j));
+		s = _mm512_add_ps(s, _mm512_maskz_loadu_ps(m, curr + j - 1));
+		s = _mm512_add_ps(s, _mm512_maskz_loadu_ps(m, curr + j + 1));
+		s = _mm512_mul_ps(s, quarter);
+		_mm512_mask_storeu_ps(out + j, m, s);
+		vdiff = _mm512_max_ps(vdiff, _mm512_abs_ps(_mm512_sub_ps(c, s)));
+	}
+	return _mm512_reduce_max_ps(vdiff);
+}
+
+__attribute__((target("avx512f")))
+static void rowUpdateAVX512F(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N)
+{
+	const __m512 quarter = _mm512_set1_ps(0.25f);
+	int j;
+
+	for ( j = 1; j < N - 1; j += 16 )
+	{
+		int left = N - 1 - j;
+		__mmask16 m = (left >= 16) ? 0xffff : (__mmask16) ((1u << left) - 1);
+		__m512 s = _mm512_add_ps(_mm512_maskz_loadu_ps(m, north + j),
+				_mm512_maskz_loadu_ps(m, south + j));
+		s = _mm512_add_ps(s, _mm512_maskz_loadu_ps(m, curr + j - 1));
+		s = _mm512_add_ps(s, _mm512_maskz_loadu_ps(m, curr + j + 1));
+		_mm512_mask_storeu_ps(out + j, m, _mm512_mul_ps(s, quarter));
+	}
+}
+#endif
+
+/*
+ * Select the row kernel.
+ *	name - "scalar", "avx2", "avx512", or NULL/"auto" for the widest one
+ *	       the CPU supports
+ *	Return: 0 on success, -1 if the name is unknown or the CPU lacks the
+ *	instructions for it
+ */
+int heat2dKernelInit(const char *name)
+{
+	int autoPick = (name == NULL || strcmp(name, "auto") == 0);
+
+	if (!autoPick && strcmp(name, "scalar") == 0)
+	{
+		heat2dRowKernel = rowKernelScalar;
+		heat2dRowUpdate = rowUpdateScalar;
+		heat2dRowKernelMasked = rowKernelMaskedScalar;
+		heat2dRowUpdateMasked = rowUpdateMaskedScalar;
+		heat2dRowKernelF = rowKernelScalarF;
+		heat2dRowUpdateF = rowUpdateScalarF;
+		kernelName = "scalar";
+		return 0;
+	}
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if ((autoPick || strcmp(name, "avx512") == 0) && __builtin_cpu_supports("avx512f"))
+	{
+		heat2dRowKernel = rowKernelAVX512;
+		heat2dRowUpdate = rowUpdateAVX512;
+		heat2dRowKernelMasked = rowKernelMaskedAVX512;
+		heat2dRowUpdateMasked = rowUpdateMaskedAVX512;
+		heat2dRowKernelF = rowKernelAVX512F;
+		heat2dRowUpdateF = rowUpdateAVX512F;
+		kernelName = "avx512";
+		return 0;
+	}
+	if ((autoPick || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+	{
+		heat2dRowKernel = rowKernelAVX2;
+		heat2dRowUpdate = rowUpdateAVX2;
+		heat2dRowKernelMasked = rowKernelMaskedAVX2;
+		heat2dRowUpdateMasked = rowUpdateMaskedAVX2;
+		heat2dRowKernelF = rowKernelAVX2F;
+		heat2dRowUpdateF = rowUpdateAVX2F;
+		kernelName = "avx2";
+		return 0;
+	}
+#endif
+	if (autoPick)
+	{
+		heat2dRowKernel = rowKernelScalar;
+		heat2dRowUpdate = rowUpdateScalar;
+		heat2dRowKernelMasked = rowKernelMaskedScalar;
+		heat2dRowUpdateMasked = rowUpdateMaskedScalar;
+		heat2dRowKernelF = rowKernelScalarF;
+		heat2dRowUpdateF = rowUpdateScalarF;
+		kernelName = "scalar";
+		return 0;
+	}
+	return -1;
+}
+
+const char *heat2dKernelName(void)
+{
+	return kernelName;
+}
@@ -0,0 +1,66 @@
+/*
+ *	Stencil row kernels
+ *
+ *	A row kernel relaxes points 1..N-2 of one row:
+ *		out[j] = (north[j] + south[j] + curr[j-1] + curr[j+1]) / 4
+ *	where curr holds the old values of the row, and returns the largest
+ *	|curr[j] - out[j]|. The rows must not overlap. Every variant performs
+ *	the same operations in the same order, so they produce bit-identical
+ *	grids; they only differ in how many points they handle per instruction.
+ *
+ *	The update-only kernels (RowUpdate, heat2dRowUpdateRB) write the same
+ *	values without tracking the change, for sweeps whose change nobody
+ *	looks at (see heat2d_converge.h).
+ *
+ *	The masked kernels (RowKernelMasked, RowUpdateMasked) relax a row of a
+ *	plate with geometry (see heat2d_geometry.h). cls holds the class byte
+ *	and source the Q of every point of the row:
+ *		n = (cls[j] & CELL_NORTH) ? north[j] : curr[j], same for s, w, e
+ *		out[j] = (cls[j] & CELL_FIXED) ? curr[j] : (n + s + w + e + source[j]) / 4
+ *	Every choice is a blend of two values, not a branch, so the cost of a
+ *	point does not depend on its class.
+ *
+ *	RowKernelF and RowUpdateF are the same kernels on single precision rows
+ *	(--precision=float|mixed): twice as many points per vector and half the
+ *	memory traffic. They too agree bit for bit between variants.
+ */
+#ifndef HEAT2D_KERNEL_H
+#define HEAT2D_KERNEL_H
+
+typedef double (*RowKernel)(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N);
+
+typedef void (*RowUpdate)(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr, int N);
+
+typedef double (*RowKernelMasked)(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N);
+
+typedef void (*RowUpdateMasked)(double *restrict out, const double *restrict north,
+		const double *restrict south, const double *restrict curr,
+		const unsigned char *restrict cls, const double *restrict source, int N);
+
+typedef float (*RowKernelF)(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N);
+
+typedef void (*RowUpdateF)(float *restrict out, const float *restrict north,
+		const float *restrict south, const float *restrict curr, int N);
+
+/* Kernels used by the solvers, set by heat2dKernelInit() */
+extern RowKernel heat2dRowKernel;
+extern RowUpdate heat2dRowUpdate;
+extern RowKernelMasked heat2dRowKernelMasked;
+extern RowUpdateMasked heat2dRowUpdateMasked;
+extern RowKernelF heat2dRowKernelF;
+extern RowUpdateF heat2dRowUpdateF;
+
+double heat2dRowKernelRB(double *restrict row, const double *restrict north,
+		const double *restrict south, int first, int N, double omega);
+void heat2dRowUpdateRB(double *restrict row, const double *restrict north,
+		const double *restrict south, int first, int N, double omega);
+
+int heat2dKernelInit(const char *name);
+const char *heat2dKernelName(void);
+
+#endif
@@ -0,0 +1,492 @@
+/*
+ *	Command line options shared by the serial and the pthread programs
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heat2d_options.h"
+#include "heat2d_solver.h"
+#include "multigrid.h"
+#include "heat2d_pcg.h"
+
+void optionsDefault(Options *opts)
+{
+	opts->kernel = "auto";
+	opts->method = METHOD_JACOBI;
+	opts->jacobi = JACOBI_AUTO;
+	opts->omega = 0;
+	opts->tbDepth = 1;
+	opts->tbHeight = 0;
+	opts->tileHeight = 0;
+	opts->tileWidth = 0;
+	opts->sleep = 0.0;
+	opts->mgCycle = MG_FMG;
+	opts->precond = PCG_SSOR;
+	opts->precision = PRECISION_DOUBLE;
+	checkPolicyDefault(&opts->check);
+	opts->format = GRID_FORMAT_BINARY;
+	opts->asyncWrite = 0;
+	opts->checkpoint = NULL;
+	opts->checkpointEvery = 1000;
+	opts->resume = NULL;
+	opts->init = "mean";
+	opts->geometry = NULL;
+	opts->affinity = NULL;
+	opts->placement = 0;
+	opts->batch = NULL;
+	opts->resolve = NULL;
+	opts->superpose = 0;
+	opts->serve = NULL;
+	opts->trace = 0;
+	opts->traceFile = NULL;
+}
+
+/*
+ * Parse a non-negative integer option value
+ * Return: 0 on success, -1 if value is not a number >= min
+ */
+static int intValue(const char *name, const char *value, int min, int *out)
+{
+	char *end;
+	long v = strtol(value, &end, 10);
+	if (*value == '\0' || *end != '\0' || v < min || v > 1000000000)
+	{
+		fprintf(stderr, "%s needs an integer >= %d\n", name, min);
+		return -1;
+	}
+	*out = (int) v;
+	return 0;
+}
+
+/*
+ * Whether the solve of an M x N plate on threads workers (0 = serial) runs
+ * ping-pong Jacobi sweeps: plain double precision sweeps of row strips;
+ * temporal blocking and tiles keep their own buffers. Ping-pong saves the
+ * halo copies and a barrier, but streams two plates instead of one, so
+ * --jacobi=auto takes it only while both plates of a strip fit in L2.
+ * parseOptions() rejects --jacobi=pingpong with the other sweeps, so only
+ * auto falls back to them here.
+ * The masked kernels of --geometry only exist for ping-pong sweeps.
+ */
+int optionsPingPong(const Options *opts, int M, int N, int threads)
+{
+	long strip = (long) M / (threads > 0 ? threads : 1) + 2;
+
+	if (opts->method != METHOD_JACOBI || opts->tbDepth > 1 || opts->tileHeight > 0 ||
+			opts->precision != PRECISION_DOUBLE)
+		return 0;
+	if (opts->geometry != NULL)
+		return 1;
+	if (opts->jacobi == JACOBI_AUTO)
+		return 2 * strip * N * (long) sizeof(double) <= heat2dCacheL2();
+	return opts->jacobi == JACOBI_PINGPONG;
+}
+
+/*
+ * Over-relaxation factor to use for an M x N plate
+ */
+double optionsOmega(const Options *opts, int M, int N)
+{
+	if (opts->omega > 0)
+		return opts->omega;
+	return heat2dOptimalOmega(M, N);
+}
+
+/*
+ * Value of "--name=value" if arg is that option, NULL otherwise
+ */
+static const char *optionValue(const char *arg, const char *name)
+{
+	size_t len = strlen(name);
+	if (strncmp(arg, name, len) == 0 && arg[len] == '=')
+		return arg + len + 1;
+	return NULL;
+}
+
+/*
+ * Pull every --option out of argv, leaving the positional arguments in
+ * order.
+ *	Return: the new argc, or -1 on an unknown or malformed option
+ */
+int parseOptions(int argc, char *argv[], Options *opts)
+{
+	int i, kept = 1;
+	const char *value;
+
+	for (i = 1; i < argc; i++)
+	{
+		char *arg = argv[i];
+		if (strncmp(arg, "--", 2) != 0)
+		{
+			argv[kept++] = arg;
+			continue;
+		}
+
+		if ((value = optionValue(arg, "--kernel")) != NULL)
+			opts->kernel = value;
+		else if ((value = optionValue(arg, "--method")) != NULL)
+		{
+			if (strcmp(value, "jacobi") == 0)
+				opts->method = METHOD_JACOBI;
+			else if (strcmp(value, "sor") == 0)
+				opts->method = METHOD_SOR;
+			else if (strcmp(value, "mg") == 0)
+				opts->method = METHOD_MG;
+			else if (strcmp(value, "cg") == 0)
+				opts->method = METHOD_CG;
+			else
+			{
+				fprintf(stderr, "unknown method '%s'\n", value);
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--jacobi")) != NULL)
+		{
+			if (strcmp(value, "auto") == 0)
+				opts->jacobi = JACOBI_AUTO;
+			else if (strcmp(value, "pingpong") == 0)
+				opts->jacobi = JACOBI_PINGPONG;
+			else if (strcmp(value, "copy") == 0)
+				opts->jacobi = JACOBI_COPY;
+			else
+			{
+				fprintf(stderr, "--jacobi must be 'auto', 'pingpong' or 'copy'\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--precision")) != NULL)
+		{
+			if (strcmp(value, "double") == 0)
+				opts->precision = PRECISION_DOUBLE;
+			else if (strcmp(value, "float") == 0)
+				opts->precision = PRECISION_FLOAT;
+			else if (strcmp(value, "mixed") == 0)
+				opts->precision = PRECISION_MIXED;
+			else
+			{
+				fprintf(stderr, "--precision must be 'double', 'float' or 'mixed'\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--mg-cycle")) != NULL)
+		{
+			if (strcmp(value, "v") == 0)
+				opts->mgCycle = MG_VCYCLE;
+			else if (strcmp(value, "fmg") == 0)
+				opts->mgCycle = MG_FMG;
+			else
+			{
+				fprintf(stderr, "--mg-cycle must be 'v' or 'fmg'\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--precond")) != NULL)
+		{
+			if (strcmp(value, "jacobi") == 0)
+				opts->precond = PCG_JACOBI;
+			else if (strcmp(value, "ssor") == 0)
+				opts->precond = PCG_SSOR;
+			else
+			{
+				fprintf(stderr, "--precond must be 'jacobi' or 'ssor'\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--check")) != NULL)
+		{
+			if (strcmp(value, "auto") == 0)
+				opts->check.every = 0;
+			else if (intValue("--check", value, 1, &opts->check.every) != 0)
+				return -1;
+		}
+		else if ((value = optionValue(arg, "--norm")) != NULL)
+		{
+			if (strcmp(value, "delta") == 0)
+				opts->check.norm = CHECK_DELTA;
+			else if (strcmp(value, "linf") == 0)
+				opts->check.norm = CHECK_LINF;
+			else if (strcmp(value, "l2") == 0)
+				opts->check.norm = CHECK_L2;
+			else
+			{
+				fprintf(stderr, "--norm must be 'delta', 'linf' or 'l2'\n");
+				return -1;
+			}
+		}
+		else if (strcmp(arg, "--async-write") == 0)
+			opts->asyncWrite = 1;
+		else if ((value = optionValue(arg, "--checkpoint")) != NULL)
+			opts->checkpoint = value;
+		else if ((value = optionValue(arg, "--checkpoint-every")) != NULL)
+		{
+			if (intValue("--checkpoint-every", value, 1, &opts->checkpointEvery) != 0)
+				return -1;
+		}
+		else if ((value = optionValue(arg, "--resume")) != NULL)
+			opts->resume = value;
+		else if ((value = optionValue(arg, "--init")) != NULL)
+			opts->init = value;
+		else if ((value = optionValue(arg, "--geometry")) != NULL)
+			opts->geometry = value;
+		else if ((value = optionValue(arg, "--affinity")) != NULL)
+		{
+			if (strcmp(value, "none") == 0)
+				opts->affinity = NULL;
+			else if (strcmp(value, "compact") == 0 || strcmp(value, "scatter") == 0 ||
+					(*value != '\0' && strspn(value, "0123456789,-") == strlen(value)))
+				opts->affinity = value;
+			else
+			{
+				fprintf(stderr, "--affinity must be 'none', 'compact', 'scatter' or a CPU list\n");
+				return -1;
+			}
+		}
+		else if (strcmp(arg, "--placement") == 0)
+			opts->placement = 1;
+		else if ((value = optionValue(arg, "--batch")) != NULL)
+			opts->batch = value;
+		else if ((value = optionValue(arg, "--resolve")) != NULL)
+			opts->resolve = value;
+		else if (strcmp(arg, "--superpose") == 0)
+			opts->superpose = 1;
+		else if ((value = optionValue(arg, "--serve")) != NULL)
+			opts->serve = value;
+		else if (strcmp(arg, "--trace") == 0)
+			opts->trace = 1;
+		else if ((value = optionValue(arg, "--trace")) != NULL)
+		{
+			opts->trace = 1;
+			opts->traceFile = value;
+		}
+		else if ((value = optionValue(arg, "--format")) != NULL)
+		{
+			if (strcmp(value, "binary") == 0)
+				opts->format = GRID_FORMAT_BINARY;
+			else if (strcmp(value, "text") == 0)
+				opts->format = GRID_FORMAT_TEXT;
+			else
+			{
+				fprintf(stderr, "--format must be 'binary' or 'text'\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--omega")) != NULL)
+		{
+			char *end;
+			if (strcmp(value, "opt") == 0)
+				opts->omega = 0;
+			else
+			{
+				opts->omega = strtod(value, &end);
+				if (*end != '\0' || opts->omega <= 0 || opts->omega >= 2)
+				{
+					fprintf(stderr, "omega must be 'opt' or in (0, 2)\n");
+					return -1;
+				}
+			}
+		}
+		else if ((value = optionValue(arg, "--tb-depth")) != NULL)
+		{
+			if (intValue("--tb-depth", value, 1, &opts->tbDepth) != 0)
+				return -1;
+		}
+		else if ((value = optionValue(arg, "--tb-height")) != NULL)
+		{
+			if (intValue("--tb-height", value, 0, &opts->tbHeight) != 0)
+				return -1;
+		}
+		else if ((value = optionValue(arg, "--tile")) != NULL)
+		{
+			char *end;
+			opts->tileHeight = (int) strtol(value, &end, 10);
+			opts->tileWidth = (*end == 'x') ? (int) strtol(end + 1, &end, 10) : 0;
+			if (*end != '\0' || opts->tileHeight < 1 || opts->tileWidth < 1)
+			{
+				fprintf(stderr, "--tile needs HxW, e.g. --tile=64x256\n");
+				return -1;
+			}
+		}
+		else if ((value = optionValue(arg, "--sleep")) != NULL)
+		{
+			char *end;
+			opts->sleep = strtod(value, &end);
+			if (*value == '\0' || *end != '\0' || opts->sleep <= 0 || opts->sleep >= 1)
+			{
+				fprintf(stderr, "--sleep needs a fraction of eps in (0, 1)\n");
+				return -1;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "unknown option '%s'\n", arg);
+			return -1;
+		}
+	}
+	if (opts->tileHeight > 0 && opts->tbDepth > 1)
+	{
+		fprintf(stderr, "--tile cannot be combined with --tb-depth\n");
+		return -1;
+	}
+	if (opts->tbDepth > 1 && opts->method != METHOD_JACOBI)
+	{
+		fprintf(stderr, "temporal blocking needs --method=jacobi\n");
+		return -1;
+	}
+	if ((opts->method == METHOD_MG || opts->method == METHOD_CG) &&
+			(opts->check.every != 1 || opts->check.norm != CHECK_DELTA))
+	{
+		fprintf(stderr, "--check and --norm apply to jacobi and sor; multigrid and\n"
+				"conjugate gradient check their residual after every cycle or iteration\n");
+		return -1;
+	}
+	if ((opts->method == METHOD_MG || opts->method == METHOD_CG) &&
+			(opts->checkpoint != NULL || opts->resume != NULL))
+	{
+		fprintf(stderr, "--checkpoint and --resume apply to jacobi and sor\n");
+		return -1;
+	}
+	if (opts->sleep > 0 && (opts->tileHeight == 0 || opts->method != METHOD_JACOBI))
+	{
+		fprintf(stderr, "--sleep puts Jacobi tiles to sleep: it needs --tile and --method=jacobi\n");
+		return -1;
+	}
+	if (opts->tileHeight > 0 && (opts->method == METHOD_MG || opts->method == METHOD_CG))
+	{
+		fprintf(stderr, "--tile cannot be combined with --method=mg or cg\n");
+		return -1;
+	}
+	if (opts->precision != PRECISION_DOUBLE &&
+			(opts->method != METHOD_JACOBI || opts->tbDepth > 1 || opts->tileHeight > 0))
+	{
+		fprintf(stderr, "--precision=float|mixed runs plain Jacobi sweeps: it cannot be\n"
+				"combined with --method, --tb-depth or --tile\n");
+		return -1;
+	}
+	if (opts->jacobi == JACOBI_PINGPONG && (opts->method != METHOD_JACOBI ||
+				opts->tbDepth > 1 || opts->tileHeight > 0 ||
+				opts->precision != PRECISION_DOUBLE))
+	{
+		fprintf(stderr, "--jacobi=pingpong runs plain double precision Jacobi sweeps: it\n"
+				"cannot be combined with --method, --tb-depth, --tile or --precision\n");
+		return -1;
+	}
+	if (opts->precision != PRECISION_DOUBLE && opts->check.norm != CHECK_DELTA)
+	{
+		fprintf(stderr, "--precision=float|mixed checks the change of a sweep only\n");
+		return -1;
+	}
+	if (opts->precision != PRECISION_DOUBLE && opts->checkpoint != NULL)
+	{
+		fprintf(stderr, "--checkpoint needs --precision=double\n");
+		return -1;
+	}
+	if (opts->batch != NULL && (opts->checkpoint != NULL || opts->resume != NULL ||
+				opts->placement || opts->tileHeight > 0))
+	{
+		fprintf(stderr, "--batch solves every plate in one thread: it cannot be combined\n"
+				"with --checkpoint, --resume, --placement or --tile\n");
+		return -1;
+	}
+	if (opts->resolve != NULL && opts->batch != NULL)
+	{
+		fprintf(stderr, "--resolve cannot be combined with --batch\n");
+		return -1;
+	}
+	if (opts->serve != NULL && (opts->batch != NULL || opts->resolve != NULL ||
+				opts->checkpoint != NULL || opts->resume != NULL || opts->placement ||
+				opts->trace || opts->asyncWrite))
+	{
+		fprintf(stderr, "--serve answers one request at a time: it cannot be combined with\n"
+				"--batch, --resolve, --checkpoint, --resume, --placement, --trace\n"
+				"or --async-write\n");
+		return -1;
+	}
+	if (opts->superpose && (opts->resolve == NULL || opts->geometry != NULL))
+	{
+		fprintf(stderr, "--superpose answers the changes of --resolve: it needs --resolve\n"
+				"and cannot be combined with --geometry\n");
+		return -1;
+	}
+	if (opts->trace && (opts->method == METHOD_MG || opts->method == METHOD_CG ||
+				opts->batch != NULL))
+	{
+		fprintf(stderr, "--trace times the threads of one jacobi or sor solve: it cannot be\n"
+				"combined with --method=mg or cg, or with --batch\n");
+		return -1;
+	}
+	if (opts->geometry != NULL && (opts->method != METHOD_JACOBI || opts->tbDepth > 1 ||
+				opts->tileHeight > 0 || opts->jacobi == JACOBI_COPY ||
+				opts->precision != PRECISION_DOUBLE || opts->check.norm != CHECK_DELTA))
+	{
+		fprintf(stderr, "--geometry runs ping-pong Jacobi sweeps in double precision with\n"
+				"--norm=delta: it cannot be combined with --method, --tb-depth, --tile,\n"
+				"--jacobi=copy, --precision or --norm\n");
+		return -1;
+	}
+	argv[kept] = NULL;
+	return kept;
+}
+
+void optionsUsage(FILE *fp)
+{
+	fprintf(fp, "options:\n");
+	fprintf(fp, "  --kernel=auto|scalar|avx2|avx512  stencil kernel (default: auto)\n");
+	fprintf(fp, "  --method=jacobi|sor|mg|cg         relaxation scheme, multigrid or preconditioned\n");
+	fprintf(fp, "                                    conjugate gradient (default: jacobi)\n");
+	fprintf(fp, "  --jacobi=auto|pingpong|copy       Jacobi sweeps from one plate into a second\n");
+	fprintf(fp, "                                    one, or in place with saved and halo rows\n");
+	fprintf(fp, "                                    (default: auto, pingpong while a thread's\n");
+	fprintf(fp, "                                    rows of both plates fit in L2)\n");
+	fprintf(fp, "  --omega=opt|W                     SOR over-relaxation factor, 0 < W < 2\n");
+	fprintf(fp, "                                    (default: opt, the optimum for M x N)\n");
+	fprintf(fp, "  --mg-cycle=v|fmg                  multigrid V-cycles only, or a full multigrid\n");
+	fprintf(fp, "                                    start first (default: fmg)\n");
+	fprintf(fp, "  --precond=jacobi|ssor             conjugate gradient preconditioner: diagonal,\n");
+	fprintf(fp, "                                    or red-black symmetric Gauss-Seidel (default: ssor)\n");
+	fprintf(fp, "  --precision=double|float|mixed    Jacobi sweeps in double, in float, or in float\n");
+	fprintf(fp, "                                    and then double to finish (default: double)\n");
+	fprintf(fp, "  --check=K|auto                    check convergence every K sweeps, or at\n");
+	fprintf(fp, "                                    adaptive intervals (default: 1)\n");
+	fprintf(fp, "  --norm=delta|linf|l2              measure compared with eps: largest change of\n");
+	fprintf(fp, "                                    a sweep, or max / RMS residual (default: delta)\n");
+	fprintf(fp, "  --format=binary|text              solution file format (default: binary)\n");
+	fprintf(fp, "  --async-write                     write the solution from a snapshot in the\n");
+	fprintf(fp, "                                    background while the program carries on\n");
+	fprintf(fp, "  --init=mean|cascade|FILE          initial interior: mean boundary temperature,\n");
+	fprintf(fp, "                                    interpolated coarse-grid solution, or a\n");
+	fprintf(fp, "                                    previous solution file resampled (default: mean)\n");
+	fprintf(fp, "  --geometry=FILE                   fixed-temperature regions, heat sources and\n");
+	fprintf(fp, "                                    insulated cutouts inside the plate, listed in\n");
+	fprintf(fp, "                                    FILE (see heat2d_geometry.h)\n");
+	fprintf(fp, "  --checkpoint=FILE                 save the plate to FILE.0 / FILE.1 in turn\n");
+	fprintf(fp, "                                    (threaded program only)\n");
+	fprintf(fp, "  --checkpoint-every=K              iterations between checkpoints (default: 1000)\n");
+	fprintf(fp, "  --resume=FILE                     continue from the newest checkpoint FILE.0 /\n");
+	fprintf(fp, "                                    FILE.1, or a binary solution file FILE\n");
+	fprintf(fp, "  --affinity=none|compact|scatter|LIST\n");
+	fprintf(fp, "                                    pin the solver threads: fill nodes and cores in\n");
+	fprintf(fp, "                                    turn, spread over them, or CPUs such as 0,2,4-7\n");
+	fprintf(fp, "                                    (threaded program only, default: none)\n");
+	fprintf(fp, "  --placement                       report the CPU and NUMA node of every thread\n");
+	fprintf(fp, "                                    and of the pages of its rows\n");
+	fprintf(fp, "  --batch=FILE                      solve the plates listed in FILE, one\n");
+	fprintf(fp, "                                    'M N Tl Tr Tt Tb eps file' per line, each in\n");
+	fprintf(fp, "                                    one thread (threaded program only)\n");
+	fprintf(fp, "  --resolve=FILE                    then re-solve for each 'Tl Tr Tt Tb file' line of\n");
+	fprintf(fp, "                                    FILE (- = stdin), starting from the last solution\n");
+	fprintf(fp, "  --superpose                       answer the --resolve lines by combining the\n");
+	fprintf(fp, "                                    solutions for a unit temperature on each edge\n");
+	fprintf(fp, "  --serve=SOCKET|-                  answer JSON line requests on a Unix socket or\n");
+	fprintf(fp, "                                    stdin, keeping the contexts of recent plate\n");
+	fprintf(fp, "                                    sizes (threaded program only, see heat2d_serve.h)\n");
+	fprintf(fp, "  --trace[=FILE]                    time compute, halo copies, barriers and checks\n");
+	fprintf(fp, "                                    of every thread and report them at the end;\n");
+	fprintf(fp, "                                    FILE gets a Chrome trace (threaded program only)\n");
+	fprintf(fp, "  --tb-depth=T                      Jacobi sweeps per temporal block (default: 1)\n");
+	fprintf(fp, "  --tb-height=H                     rows per temporal block tile (default: from L2)\n");
+	fprintf(fp, "  --tile=HxW                        split the plate into H x W tiles scheduled with\n");
+	fprintf(fp, "                                    work stealing (default: one row strip per thread)\n");
+	fprintf(fp, "  --sleep=F                         skip tiles that changed by less than F * eps\n");
+	fprintf(fp, "                                    until their edges move by as much; a sweep of\n");
+	fprintf(fp, "                                    all tiles confirms convergence (needs --tile)\n");
+}
@@ -0,0 +1,61 @@
+/*
+ *	Command line options shared by the serial and the pthread programs
+ *
+ *	Options are given as --name or --name=value anywhere on the command
+ *	line; everything else is left in argv as a positional argument.
+ */
+#ifndef HEAT2D_OPTIONS_H
+#define HEAT2D_OPTIONS_H
+
+#include <stdio.h>
+#include "heat2d_converge.h"
+#include "grid.h"
+
+#define METHOD_JACOBI 0
+#define METHOD_SOR 1
+#define METHOD_MG 2
+#define METHOD_CG 3
+
+#define JACOBI_AUTO 0		//ping-pong while both plates of a strip fit in L2
+#define JACOBI_COPY 1		//sweep in place, saving rows and halo rows
+#define JACOBI_PINGPONG 2	//sweep from one plate into a second one
+
+typedef struct {
+	const char *kernel;		//row kernel: auto, scalar, avx2, avx512
+	int method;				//METHOD_JACOBI, METHOD_SOR, METHOD_MG or METHOD_CG
+	int jacobi;				//JACOBI_AUTO, JACOBI_COPY or JACOBI_PINGPONG
+	double omega;			//SOR over-relaxation factor, <= 0 picks the optimal one
+	int tbDepth;			//Jacobi sweeps per temporal block (1 = no blocking)
+	int tbHeight;			//rows per temporal block tile, 0 = from L2 size
+	int tileHeight;			//2D tile decomposition (--tile=HxW), 0 = row strips
+	int tileWidth;
+	double sleep;			//tiles changing by less than sleep * eps are skipped, 0 = never
+	int mgCycle;			//MG_VCYCLE or MG_FMG
+	int precond;			//PCG_JACOBI or PCG_SSOR
+	int precision;			//PRECISION_DOUBLE, PRECISION_FLOAT or PRECISION_MIXED
+	CheckPolicy check;		//when and how convergence is checked
+	int format;				//GRID_FORMAT_BINARY or GRID_FORMAT_TEXT
+	int asyncWrite;			//write the solution from a snapshot in the background
+	const char *checkpoint;	//base name of the checkpoint slots, NULL = none
+	int checkpointEvery;	//iterations between checkpoints
+	const char *resume;		//checkpoint to continue from, NULL = start afresh
+	const char *init;		//initial guess: "mean", "cascade" or a solution file
+	const char *geometry;	//fixed points, sources and cutouts (--geometry), NULL = none
+	const char *affinity;	//"compact", "scatter" or a CPU list, NULL = not pinned
+	int placement;			//report where the threads and their rows ended up
+	const char *batch;		//job list of many plates (--batch), NULL = one plate
+	const char *resolve;	//boundary changes to re-solve after the plate (--resolve), NULL = none
+	int superpose;			//answer them from unit solutions (--superpose)
+	const char *serve;		//Unix socket or "-" to answer requests on (--serve), NULL = none
+	int trace;				//time the phases of every worker (--trace)
+	const char *traceFile;	//Chrome trace JSON of those phases, NULL = none
+} Options;
+
+double optionsOmega(const Options *opts, int M, int N);
+int optionsPingPong(const Options *opts, int M, int N, int threads);
+
+void optionsDefault(Options *opts);
+int parseOptions(int argc, char *argv[], Options *opts);
+void optionsUsage(FILE *fp);
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *	Preconditioned conjugate gradient solver for the steady state plate
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "heat2d_pcg.h"
+#include "heat2d_solver.h"
+
+/* Interior rows of the plate handled by rank */
+static void pcgRows(int M, int rank, int threads, int *first, int *last)
+{
+	*first = 1 + (int) ((long) (M - 2) * rank / threads);
+	*last = (int) ((long) (M - 2) * (rank + 1) / threads);
+}
+
+/*
+ * Zero rows first..last of r, z, p and q; pcgSolve() does it for the rows
+ * of each thread, so their pages are first touched, and placed, on the
+ * thread's NUMA node
+ */
+static void pcgZero(Pcg *cg, int first, int last)
+{
+	size_t bytes = (size_t) (last - first + 1) * cg->r.stride * sizeof(double);
+
+	memset(GRID_ROW(&cg->r, first), 0, bytes);
+	memset(GRID_ROW(&cg->z, first), 0, bytes);
+	memset(GRID_ROW(&cg->p, first), 0, bytes);
+	memset(GRID_ROW(&cg->q, first), 0, bytes);
+}
+
+/*
+ * Set up the vectors of CG on the plate u
+ * Return: 0 on success, -1 if memory could not be allocated
+ */
+int pcgInit(Pcg *cg, Grid *u, int threads, int precond)
+{
+	memset(cg, 0, sizeof(*cg));
+	cg->u = u;
+	cg->precond = precond;
+	cg->threads = threads;
+	barrierInit(&cg->bar, threads);
+	cg->sense = calloc(threads, sizeof(int));
+	if (cg->sense == NULL)
+		return -1;
+	if (gridAlloc(&cg->r, u->M, u->N) != 0 || gridAlloc(&cg->z, u->M, u->N) != 0 ||
+			gridAlloc(&cg->p, u->M, u->N) != 0 || gridAlloc(&cg->q, u->M, u->N) != 0)
+		return -1;
+	cg->rowPQ = calloc(u->M, sizeof(double));
+	cg->rowRZ = calloc(u->M, sizeof(double));
+	cg->rowMax = calloc(u->M, sizeof(double));
+	if (cg->rowPQ == NULL || cg->rowRZ == NULL || cg->rowMax == NULL)
+		return -1;
+	return 0;
+}
+
+void pcgFree(Pcg *cg)
+{
+	gridFree(&cg->r);
+	gridFree(&cg->z);
+	gridFree(&cg->p);
+	gridFree(&cg->q);
+	free(cg->rowPQ);
+	free(cg->rowRZ);
+	free(cg->rowMax);
+	free(cg->sense);
+	cg->rowPQ = cg->rowRZ = cg->rowMax = NULL;
+	cg->sense = NULL;
+}
+
+/* Sum of the interior rows of a per-row array, in row order */
+static double pcgSum(const double *row, int M)
+{
+	double sum = 0.0;
+	int i;
+	for (i = 1; i < M - 1; i++)
+		sum += row[i];
+	return sum;
+}
+
+/* Largest value of the interior rows of a per-row array */
+static double pcgMax(const double *row, int M)
+{
+	double max = 0.0;
+	int i;
+	for (i = 1; i < M - 1; i++)
+		max = (row[i] > max) ? row[i] : max;
+	return max;
+}
+
+/*
+ * r = b - A u, the sum of the four neighbours minus 4 u, and z = r / 4 on
+ * rows first..last; rowMax gets the largest |r| of every row
+ */
+static void pcgResidual(Pcg *cg, int first, int last)
+{
+	int N = cg->u->N;
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		const double *row = GRID_ROW(cg->u, i);
+		const double *n = GRID_ROW(cg->u, i - 1);
+		const double *s = GRID_ROW(cg->u, i + 1);
+		double *r = GRID_ROW(&cg->r, i);
+		double *z = GRID_ROW(&cg->z, i);
+		double rmax = 0.0;
+		for (j = 1; j < N - 1; j++)
+		{
+			r[j] = n[j] + s[j] + row[j-1] + row[j+1] - 4.0 * row[j];
+			z[j] = 0.25 * r[j];
+			rmax = (fabs(r[j]) > rmax) ? fabs(r[j]) : rmax;
+		}
+		cg->rowMax[i] = rmax;
+	}
+}
+
+/*
+ * q = A p on rows first..last; rowPQ gets p . q of every row
+ */
+static void pcgApply(Pcg *cg, int first, int last)
+{
+	int N = cg->u->N;
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		const double *p = GRID_ROW(&cg->p, i);
+		const double *n = GRID_ROW(&cg->p, i - 1);
+		const double *s = GRID_ROW(&cg->p, i + 1);
+		double *q = GRID_ROW(&cg->q, i);
+		double pq = 0.0;
+		for (j = 1; j < N - 1; j++)
+		{
+			q[j] = 4.0 * p[j] - n[j] - s[j] - p[j-1] - p[j+1];
+			pq += p[j] * q[j];
+		}
+		cg->rowPQ[i] = pq;
+	}
+}
+
+/*
+ * u += alpha p, r -= alpha q and z = r / 4 on rows first..last; rowMax
+ * gets the largest |r| of every row
+ */
+static void pcgUpdate(Pcg *cg, int first, int last, double alpha)
+{
+	int N = cg->u->N;
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		double *u = GRID_ROW(cg->u, i);
+		double *r = GRID_ROW(&cg->r, i);
+		double *z = GRID_ROW(&cg->z, i);
+		const double *p = GRID_ROW(&cg->p, i);
+		const double *q = GRID_ROW(&cg->q, i);
+		double rmax = 0.0;
+		for (j = 1; j < N - 1; j++)
+		{
+			u[j] += alpha * p[j];
+			r[j] -= alpha * q[j];
+			z[j] = 0.25 * r[j];
+			rmax = (fabs(r[j]) > rmax) ? fabs(r[j]) : rmax;
+		}
+		cg->rowMax[i] = rmax;
+	}
+}
+
+/*
+ * z += 1/4 of the four neighbours in z, on the points of one colour of
+ * rows first..last (a Gauss-Seidel step of A z = r for that colour, as
+ * the points of the colour already hold r / 4)
+ */
+static void pcgRelax(Pcg *cg, int first, int last, int color)
+{
+	int N = cg->u->N;
+	int i, j;
+
+	for (i = first; i <= last; i++)
+	{
+		double *z = GRID_ROW(&cg->z, i);
+		const double *n = GRID_ROW(&cg->z, i - 1);
+		const double *s = GRID_ROW(&cg->z, i + 1);
+		for (j = ((i + 1) % 2 == color) ? 1 : 2; j < N - 1; j += 2)
+			z[j] += 0.25 * (n[j] + s[j] + z[j-1] + z[j+1]);
+	}
+}
+
+/*
+ * Finish z = M^-1 r from z = r / 4, which is the Jacobi preconditioner
+ * already; rowRZ gets r . z of every row of rows first..last.
+ * SSOR relaxes the black points from the red ones, then the red points
+ * again from the black ones: the forward sweep of red-black Gauss-Seidel
+ * for the black points and the backward one for the red points. Its
+ * constant factor is left out, CG does not depend on it.
+ */
+static void pcgPrecond(Pcg *cg, int *sense, int first, int last)
+{
+	int N = cg->u->N;
+	int i, j;
+
+	if (cg->precond == PCG_SSOR)
+	{
+		barrierWait(&cg->bar, sense);
+		pcgRelax(cg, first, last, BLACK);
+		barrierWait(&cg->bar, sense);
+		pcgRelax(cg, first, last, RED);
+	}
+	for (i = first; i <= last; i++)
+	{
+		const double *r = GRID_ROW(&cg->r, i);
+		const double *z = GRID_ROW(&cg->z, i);
+		double rz = 0.0;
+		for (j = 1; j < N - 1; j++)
+			rz += r[j] * z[j];
+		cg->rowRZ[i] = rz;
+	}
+}
+
+/* pcgSolve
+ *	Called by each of the cg->threads threads with its rank.
+ *	Runs CG iterations until the largest residual of the plate, divided by
+ *	the stencil's diagonal (4), is below eps: how much one more Jacobi sweep
+ *	would change the plate, so eps means the same as for the relaxation
+ *	solvers. The recurrence for the residual drifts by rounding, so at that
+ *	point it is taken again from the plate, and CG restarts from there if
+ *	it is still above eps.
+ *	print - print iteration information (rank 0)
+ *
+ *	returns
+ *	    - number of iterations
+ *	    - the plate contains the final temperature distribution
+ */
+int pcgSolve(Pcg *cg, int rank, double eps, int print, double *tol)
+{
+	int M = cg->u->M, N = cg->u->N;
+	int *sense = &cg->sense[rank];
+	int iterations = 0;
+	int iterations_print = 1;
+	int first, last, i;
+	double change, rz, rzNext, alpha, beta;
+
+	if (M < 3 || N < 3)
+	{
+		*tol = 0.0;
+		return 0;
+	}
+	pcgRows(M, rank, cg->threads, &first, &last);
+	//This thread's rows, the boundary rows with the first and last thread
+	//(the boundary stays 0); the barrier at the top of the loop orders them
+	//before any read
+	pcgZero(cg, (rank == 0) ? 0 : first, (rank == cg->threads - 1) ? M - 1 : last);
+	if (print && rank == 0)
+		printf( "\n Iteration  Change\n" );
+
+	for (;;)
+	{
+		//Every row of the plate is final: start from its true residual
+		barrierWait(&cg->bar, sense);
+		pcgResidual(cg, first, last);
+		pcgPrecond(cg, sense, first, last);
+		for (i = first; i <= last; i++)
+			memcpy(GRID_ROW(&cg->p, i), GRID_ROW(&cg->z, i), N * sizeof(double));
+		barrierWait(&cg->bar, sense);
+		rz = pcgSum(cg->rowRZ, M);
+		change = pcgMax(cg->rowMax, M) / 4.0;
+		if (change < eps)
+			break;
+
+		while ( eps <= change )
+		{
+			pcgApply(cg, first, last);
+			barrierWait(&cg->bar, sense);
+			alpha = rz / pcgSum(cg->rowPQ, M);
+			pcgUpdate(cg, first, last, alpha);
+			pcgPrecond(cg, sense, first, last);
+			barrierWait(&cg->bar, sense);
+			rzNext = pcgSum(cg->rowRZ, M);
+			change = pcgMax(cg->rowMax, M) / 4.0;
+			iterations++;
+			if ( print && rank == 0 && iterations >= iterations_print )
+			{
+				printf ( "  %8d  %f\n", iterations, change );
+				while (iterations_print <= iterations)
+					iterations_print *= 2;
+			}
+			if (change < eps)
+				break;
+
+			//p = z + beta p; the barrier orders it before the next A p
+			beta = rzNext / rz;
+			rz = rzNext;
+			for (i = first; i <= last; i++)
+			{
+				double *p = GRID_ROW(&cg->p, i);
+				const double *z = GRID_ROW(&cg->z, i);
+				int j;
+				for (j = 1; j < N - 1; j++)
+					p[j] = z[j] + beta * p[j];
+			}
+			barrierWait(&cg->bar, sense);
+		}
+	}
+	*tol = change;
+	return iterations;
+}
@@ -0,0 +1,52 @@
+/*
+ *	Preconditioned conjugate gradient solver for the steady state plate
+ *
+ *	The interior points of the plate are the unknowns of A x = b, where A
+ *	is the 5-point Laplacian (4 on the diagonal, -1 for each interior
+ *	neighbour) and b holds the fixed boundary temperatures next to the
+ *	edges. A is never stored: every product is a stencil sweep, and the
+ *	boundary only enters through the first residual, b - A x = the sum of
+ *	the four neighbours minus 4 x, taken on the initial plate.
+ *
+ *	CG needs O(N) iterations on an N x N plate where Jacobi needs O(N^2).
+ *	The preconditioners are
+ *
+ *	PCG_JACOBI - the diagonal of A
+ *	PCG_SSOR - one symmetric red-black Gauss-Seidel sweep (SSOR with
+ *		omega = 1): red points from the residual, black points from those,
+ *		then the red points again from the black ones
+ *
+ *	All the operations are split over rows between cg->threads threads that
+ *	call pcgSolve() together and meet at cg->bar. Dot products are summed
+ *	per row and then over the rows in order, by every thread, so the result
+ *	does not depend on the number of threads.
+ */
+#ifndef HEAT2D_PCG_H
+#define HEAT2D_PCG_H
+
+#include "grid.h"
+#include "barrier.h"
+
+#define PCG_JACOBI 0
+#define PCG_SSOR 1
+
+typedef struct {
+	Grid *u;			//the plate: initial guess, then the solution
+	Grid r;				//residual b - A u
+	Grid z;				//preconditioned residual
+	Grid p;				//search direction
+	Grid q;				//A p
+	double *rowPQ;		//p . q of every row
+	double *rowRZ;		//r . z of every row
+	double *rowMax;		//largest |r| of every row
+	int precond;		//PCG_JACOBI or PCG_SSOR
+	int threads;
+	Barrier bar;
+	int *sense;			//local sense of every thread for bar, kept across solves
+} Pcg;
+
+int pcgInit(Pcg *cg, Grid *u, int threads, int precond);
+void pcgFree(Pcg *cg);
+int pcgSolve(Pcg *cg, int rank, double eps, int print, double *tol);
+
+#endif
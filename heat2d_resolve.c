@@ -0,0 +1,97 @@
+/*
+ *	Re-solve mode (--resolve): boundary changes applied to a solved plate
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "heat2d_resolve.h"
+
+#define RESOLVE_LINE 4096
+
+static double resolveClock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Apply every line of the list at path to the plate in h, which holds a
+ * solution with tolerance eps, and write each new steady state to its file.
+ *	scale - solve the unit solutions to eps / scale first and superpose
+ *		them (see heat2dBasis); 0 re-solves from the last solution
+ *	report - gets one line per change, flushed at once
+ * Return: number of lines that failed, -1 if the list cannot be opened or
+ *	the unit solutions cannot be solved
+ */
+int resolveRun(Heat2d *h, const char *path, double eps, double scale, FILE *report)
+{
+	FILE *fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+	char buf[RESOLVE_LINE];
+	char file[RESOLVE_LINE];
+	int line = 0, failed = 0;
+	double start;
+
+	if (fp == NULL)
+	{
+		fprintf(stderr, "heat2d: cannot open the boundary changes '%s'\n", path);
+		return -1;
+	}
+	if (scale > 0)
+	{
+		int iterations;
+
+		start = resolveClock();
+		iterations = heat2dBasis(h, scale);
+		if (iterations < 0)
+		{
+			if (fp != stdin)
+				fclose(fp);
+			return -1;
+		}
+		fprintf(report, "\n  Unit solutions to %G: %d iterations, %f s\n", eps / scale,
+				iterations, resolveClock() - start);
+		fflush(report);
+	}
+
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		char *comment = strchr(buf, '#');
+		double Tl, Tr, Tt, Tb;
+		int used = 0;
+
+		line++;
+		if (comment != NULL)
+			*comment = '\0';
+		if (strspn(buf, " \t\r\n") == strlen(buf))
+			continue;
+		if (sscanf(buf, "%lf %lf %lf %lf %4095s %n", &Tl, &Tr, &Tt, &Tb, file, &used) != 5 ||
+				buf[used] != '\0')
+		{
+			fprintf(stderr, "heat2d: %s:%d: expected Tl Tr Tt Tb file\n", path, line);
+			failed++;
+			continue;
+		}
+
+		start = resolveClock();
+		heat2dSetBoundary(h, Tl, Tr, Tt, Tb);
+		if ((scale <= 0 || heat2dChange(h) >= eps) && heat2dRun(h) < 0)
+		{
+			failed++;
+			continue;
+		}
+		if (heat2dWrite(h, file) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot write '%s'\n", file);
+			failed++;
+			continue;
+		}
+		fprintf(report, "  %s: %G %G %G %G, %d iterations, change %f, %f s\n", file,
+				Tl, Tr, Tt, Tb, heat2dIterations(h), heat2dChange(h), resolveClock() - start);
+		fflush(report);
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return failed;
+}
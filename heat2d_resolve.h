@@ -0,0 +1,29 @@
+/*
+ *	Re-solve mode (--resolve): boundary changes applied to a solved plate
+ *
+ *	After the plate of the command line is solved, every line of the list
+ *	gives new edge temperatures and a solution file:
+ *
+ *		Tl Tr Tt Tb file
+ *
+ *	Blank lines are skipped and '#' starts a comment. The list "-" is read
+ *	from stdin as lines arrive, so a control loop can keep one process and
+ *	feed it changes. Each line keeps the last solution as the initial guess
+ *	(heat2dSetBoundary) and re-converges from there, which after a small
+ *	change takes a fraction of the iterations of a solve from the mean.
+ *
+ *	With --superpose the four unit solutions are solved first
+ *	(heat2dBasis) and every line is answered by combining them, with no
+ *	iterations at all. They are solved to eps over twice the sum of the
+ *	absolute edge temperatures of the command line; a line whose bound on
+ *	the change is still above eps is finished with a run.
+ */
+#ifndef HEAT2D_RESOLVE_H
+#define HEAT2D_RESOLVE_H
+
+#include <stdio.h>
+#include "libheat2d.h"
+
+int resolveRun(Heat2d *h, const char *path, double eps, double scale, FILE *report);
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ *	Server mode (--serve): a resident solver answering requests
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "heat2d_serve.h"
+#include "libheat2d.h"
+#include "affinity.h"
+
+#define SERVE_LINE 4096
+#define SERVE_FIELDS 16
+#define SERVE_KEY 32
+#define SERVE_VALUE 1024
+
+//One "key": value pair of a request
+typedef struct {
+	char key[SERVE_KEY];
+	char value[SERVE_VALUE];
+	int string;				//value was a JSON string
+} JsonField;
+
+//A kept context and the plate size it was made for
+typedef struct {
+	Heat2d *h;				//NULL = free slot
+	int M, N;
+	unsigned long used;		//request that last used it
+} ServeContext;
+
+typedef struct {
+	int threads;
+	const Options *opts;
+	ThreadPool *pool;		//the workers of every context
+	ServeContext ctx[SERVE_CONTEXTS];
+	unsigned long requests;	//solve requests so far, the clock of ServeContext.used
+	long created;			//contexts created ...
+	long reused;			//... reset for a plate of their size ...
+	long resized;			//... and for a plate of another size
+	double *latency;		//ms of every solve request answered
+	int timed, size;
+} Server;
+
+static double serveClock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *jsonSpace(const char *s)
+{
+	while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+		s++;
+	return s;
+}
+
+/*
+ * Copy the JSON string whose opening quote is just before s into out
+ * Return: the character after the closing quote, NULL if the string is
+ *	malformed or too long
+ */
+static const char *jsonString(const char *s, char *out, size_t size)
+{
+	size_t n = 0;
+
+	while (*s != '"')
+	{
+		char c = *s++;
+		if (c == '\0')
+			return NULL;
+		if (c == '\\')
+		{
+			c = *s++;
+			if (c == 'n')
+				c = '\n';
+			else if (c == 't')
+				c = '\t';
+			else if (c != '"' && c != '\\' && c != '/')
+				return NULL;
+		}
+		if (n + 1 >= size)
+			return NULL;
+		out[n++] = c;
+	}
+	out[n] = '\0';
+	return s + 1;
+}
+
+/*
+ * Split a flat JSON object (string, number, true, false or null values)
+ * into its fields
+ * Return: number of fields, -1 if s is not such an object
+ */
+static int jsonParse(const char *s, JsonField *f, int max)
+{
+	int n = 0;
+
+	s = jsonSpace(s);
+	if (*s++ != '{')
+		return -1;
+	s = jsonSpace(s);
+	if (*s == '}')
+		return (*jsonSpace(s + 1) == '\0') ? 0 : -1;
+	for (;;)
+	{
+		if (n == max || *s++ != '"' || (s = jsonString(s, f[n].key, SERVE_KEY)) == NULL)
+			return -1;
+		s = jsonSpace(s);
+		if (*s++ != ':')
+			return -1;
+		s = jsonSpace(s);
+		f[n].string = (*s == '"');
+		if (f[n].string)
+		{
+			if ((s = jsonString(s + 1, f[n].value, SERVE_VALUE)) == NULL)
+				return -1;
+		}
+		else
+		{
+			size_t len = strcspn(s, ",} \t\r\n");
+			if (len == 0 || len >= SERVE_VALUE)
+				return -1;
+			memcpy(f[n].value, s, len);
+			f[n].value[len] = '\0';
+			s += len;
+		}
+		n++;
+		s = jsonSpace(s);
+		if (*s == '}')
+			return (*jsonSpace(s + 1) == '\0') ? n : -1;
+		if (*s++ != ',')
+			return -1;
+		s = jsonSpace(s);
+	}
+}
+
+static const JsonField *jsonField(const JsonField *f, int n, const char *key)
+{
+	int k;
+	for (k = 0; k < n; k++)
+		if (strcmp(f[k].key, key) == 0)
+			return &f[k];
+	return NULL;
+}
+
+/*
+ * Number field key of a request
+ * Return: 0, -1 if it is missing or not a number
+ */
+static int jsonNumber(const JsonField *f, int n, const char *key, double *out)
+{
+	const JsonField *v = jsonField(f, n, key);
+	char *end;
+
+	if (v == NULL || v->string)
+		return -1;
+	*out = strtod(v->value, &end);
+	return (*end == '\0' && isfinite(*out)) ? 0 : -1;
+}
+
+/* s as a JSON string */
+static void jsonPut(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s != '\0'; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char) *s < 0x20)
+			fprintf(fp, "\\u%04x", (unsigned char) *s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/* Start of a response: the id of the request, if it had one */
+static void respondStart(FILE *out, const JsonField *id)
+{
+	fputc('{', out);
+	if (id == NULL)
+		return;
+	fputs("\"id\": ", out);
+	if (id->string)
+		jsonPut(out, id->value);
+	else
+		fputs(id->value, out);
+	fputs(", ", out);
+}
+
+static void respondError(FILE *out, const JsonField *id, const char *error)
+{
+	respondStart(out, id);
+	fputs("\"status\": \"error\", \"error\": ", out);
+	jsonPut(out, error);
+	fputs("}\n", out);
+	fflush(out);
+}
+
+/*
+ * Context for an M x N plate with the given boundary and eps, ready to run:
+ * a kept one of that size reset to the new plate, or a new one in a free
+ * slot. Once every slot is taken, the least recently used context whose
+ * buffers hold the plate is resized to it, or the least recently used one
+ * of all if none does, and grows its buffers.
+ * Return: NULL if the plate cannot be set up (reported on stderr)
+ */
+static Heat2d *serveContext(Server *s, int M, int N, double Tl, double Tr, double Tt,
+		double Tb, double eps)
+{
+	size_t bytes = (size_t) M * gridStride(N) * sizeof(double);
+	ServeContext *slot = &s->ctx[0];
+	ServeContext *fit = NULL;
+	Heat2dConfig cfg;
+	int k;
+
+	for (k = 0; k < SERVE_CONTEXTS; k++)
+	{
+		ServeContext *c = &s->ctx[k];
+		if (c->h != NULL && c->M == M && c->N == N)
+		{
+			c->used = s->requests;
+			s->reused++;
+			return (heat2dReset(c->h, Tl, Tr, Tt, Tb, eps) == 0) ? c->h : NULL;
+		}
+		if (c->h != NULL && heat2dRoom(c->h) >= bytes && (fit == NULL || c->used < fit->used))
+			fit = c;
+		if (c->h == NULL || c->used < slot->used)
+			slot = c;
+	}
+
+	if (slot->h != NULL)
+	{
+		if (fit == NULL)
+			fit = slot;
+		fit->used = s->requests;
+		s->resized++;
+		if (heat2dResize(fit->h, M, N, Tl, Tr, Tt, Tb, eps) != 0)
+		{
+			heat2dDestroy(fit->h);
+			fit->h = NULL;
+			return NULL;
+		}
+		fit->M = M;
+		fit->N = N;
+		return fit->h;
+	}
+
+	heat2dConfigDefault(&cfg);
+	cfg.M = M;
+	cfg.N = N;
+	cfg.Tl = Tl;
+	cfg.Tr = Tr;
+	cfg.Tt = Tt;
+	cfg.Tb = Tb;
+	cfg.eps = eps;
+	cfg.threads = s->threads;
+	cfg.pool = s->pool;
+	cfg.opts = *s->opts;
+	slot->h = heat2dCreate(&cfg);
+	if (slot->h == NULL)
+		return NULL;
+	slot->M = M;
+	slot->N = N;
+	slot->used = s->requests;
+	s->created++;
+	return slot->h;
+}
+
+static int compareMs(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Latency percentile q (nearest rank) of the sorted latencies
+ */
+static double percentile(const double *sorted, int count, double q)
+{
+	int rank = (int) ceil(q * count);
+	return (count > 0) ? sorted[(rank > 0) ? rank - 1 : 0] : 0.0;
+}
+
+/*
+ * p50, p90, p99 and max of the solve latencies so far into ms[4]
+ */
+static void serveLatency(const Server *s, double ms[4])
+{
+	int count = s->timed;
+	double *sorted = malloc((count > 0 ? count : 1) * sizeof(double));
+
+	ms[0] = ms[1] = ms[2] = ms[3] = 0.0;
+	if (sorted == NULL)
+		return;
+	memcpy(sorted, s->latency, count * sizeof(double));
+	qsort(sorted, count, sizeof(double), compareMs);
+	ms[0] = percentile(sorted, count, 0.50);
+	ms[1] = percentile(sorted, count, 0.90);
+	ms[2] = percentile(sorted, count, 0.99);
+	ms[3] = (count > 0) ? sorted[count - 1] : 0.0;
+	free(sorted);
+}
+
+static void serveStats(const Server *s, FILE *out, const JsonField *id)
+{
+	double ms[4];
+
+	serveLatency(s, ms);
+	respondStart(out, id);
+	fprintf(out, "\"status\": \"ok\", \"requests\": %d, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+			"\"p99_ms\": %.3f, \"max_ms\": %.3f, \"contexts_created\": %ld, "
+			"\"contexts_reused\": %ld, \"contexts_resized\": %ld}\n", s->timed, ms[0],
+			ms[1], ms[2], ms[3], s->created, s->reused, s->resized);
+	fflush(out);
+}
+
+/*
+ * Solve the plate of one request and send the response, and the solution
+ * when it goes inline
+ */
+static void serveSolve(Server *s, const JsonField *f, int n, FILE *out, double start)
+{
+	const JsonField *id = jsonField(f, n, "id");
+	const JsonField *format = jsonField(f, n, "format");
+	const JsonField *path = jsonField(f, n, "out");
+	double M, N, Tl, Tr, Tt, Tb, eps;
+	int fmt = GRID_FORMAT_BINARY;
+	char *payload = NULL;
+	size_t bytes = 0;
+	GridInfo info;
+	Heat2d *h;
+
+	if (jsonNumber(f, n, "M", &M) != 0 || jsonNumber(f, n, "N", &N) != 0 ||
+			jsonNumber(f, n, "Tl", &Tl) != 0 || jsonNumber(f, n, "Tr", &Tr) != 0 ||
+			jsonNumber(f, n, "Tt", &Tt) != 0 || jsonNumber(f, n, "Tb", &Tb) != 0 ||
+			jsonNumber(f, n, "eps", &eps) != 0)
+	{
+		respondError(out, id, "a solve needs numbers M, N, Tl, Tr, Tt, Tb and eps");
+		return;
+	}
+	if (M != floor(M) || N != floor(N) || M < 1 || N < 1 || M > 1000000 || N > 1000000 ||
+			eps < 0)
+	{
+		respondError(out, id, "M and N must be whole numbers from 1 to 1000000 and eps >= 0");
+		return;
+	}
+	if (format != NULL && strcmp(format->value, "text") == 0)
+		fmt = GRID_FORMAT_TEXT;
+	else if (format != NULL && strcmp(format->value, "binary") != 0)
+	{
+		respondError(out, id, "format must be \"binary\" or \"text\"");
+		return;
+	}
+
+	s->requests++;
+	h = serveContext(s, (int) M, (int) N, Tl, Tr, Tt, Tb, eps);
+	if (h == NULL || heat2dRun(h) < 0)
+	{
+		respondError(out, id, "the plate could not be set up or solved");
+		return;
+	}
+	info.Tl = Tl;
+	info.Tr = Tr;
+	info.Tt = Tt;
+	info.Tb = Tb;
+	info.iterations = heat2dIterations(h);
+	info.tol = heat2dChange(h);
+	if (path != NULL)
+	{
+		if (gridWriteFile(path->value, heat2dPlate(h), &info, fmt) != 0)
+		{
+			respondError(out, id, "the solution file could not be written");
+			return;
+		}
+	}
+	else
+	{
+		FILE *mem = open_memstream(&payload, &bytes);
+		int status = (mem == NULL) ? -1 : 0;
+
+		if (mem != NULL && fmt == GRID_FORMAT_TEXT)
+			gridWriteText(mem, heat2dPlate(h));
+		else if (mem != NULL)
+			status = gridWriteBinary(mem, heat2dPlate(h), &info);
+		if (mem != NULL && (fclose(mem) != 0 || status != 0))
+			status = -1;
+		if (status != 0)
+		{
+			free(payload);
+			respondError(out, id, "out of memory for the inline solution");
+			return;
+		}
+	}
+
+	respondStart(out, id);
+	fprintf(out, "\"status\": \"ok\", \"iterations\": %d, \"change\": %.9g, \"ms\": %.3f",
+			info.iterations, info.tol, (serveClock() - start) * 1e3);
+	if (path == NULL)
+		fprintf(out, ", \"bytes\": %zu", bytes);
+	fputs("}\n", out);
+	if (path == NULL)
+		fwrite(payload, 1, bytes, out);
+	fflush(out);
+	free(payload);
+
+	//The latency of a request runs until its answer is sent
+	if (s->timed == s->size)
+	{
+		int size = (s->size > 0) ? 2 * s->size : 1024;
+		double *grown = realloc(s->latency, size * sizeof(double));
+		if (grown == NULL)
+			return;
+		s->latency = grown;
+		s->size = size;
+	}
+	s->latency[s->timed++] = (serveClock() - start) * 1e3;
+}
+
+/*
+ * Answer the requests of one client, a line each
+ * Return: 1 if a request asked the server to stop, 0 at the end of input
+ */
+static int serveStream(Server *s, FILE *in, FILE *out)
+{
+	char buf[SERVE_LINE];
+
+	while (fgets(buf, sizeof(buf), in) != NULL)
+	{
+		JsonField f[SERVE_FIELDS];
+		const JsonField *cmd;
+		double start = serveClock();
+		int n;
+
+		if (strchr(buf, '\n') == NULL && !feof(in))
+		{
+			int c;
+			while ((c = fgetc(in)) != EOF && c != '\n')
+				;
+			respondError(out, NULL, "request line too long");
+			continue;
+		}
+		if (strspn(buf, " \t\r\n") == strlen(buf))
+			continue;
+		n = jsonParse(buf, f, SERVE_FIELDS);
+		if (n < 0)
+		{
+			respondError(out, NULL, "expected a flat JSON object");
+			continue;
+		}
+		cmd = jsonField(f, n, "cmd");
+		if (cmd == NULL || strcmp(cmd->value, "solve") == 0)
+			serveSolve(s, f, n, out, start);
+		else if (strcmp(cmd->value, "stats") == 0)
+			serveStats(s, out, jsonField(f, n, "id"));
+		else if (strcmp(cmd->value, "shutdown") == 0)
+		{
+			respondStart(out, jsonField(f, n, "id"));
+			fputs("\"status\": \"ok\"}\n", out);
+			fflush(out);
+			return 1;
+		}
+		else
+			respondError(out, jsonField(f, n, "id"), "cmd must be solve, stats or shutdown");
+	}
+	return 0;
+}
+
+/*
+ * Listening Unix socket at path; a socket left there by an earlier server
+ * is replaced, any other file is not
+ * Return: the socket, -1 on failure (reported on stderr)
+ */
+static int serveListen(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "heat2d: socket path '%s' is too long\n", path);
+		return -1;
+	}
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot listen on '%s': %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Serve requests on stdin / stdout (where = "-") or on the Unix socket
+ * where, solving them with threads workers and opts, until a shutdown
+ * request or the end of stdin. The latency percentiles go to stderr at
+ * the end.
+ * Return: 0, -1 if the workers or the socket cannot be set up
+ */
+int serveRun(const char *where, int threads, const Options *opts)
+{
+	Server s;
+	double ms[4];
+	int k;
+
+	memset(&s, 0, sizeof(s));
+	s.threads = threads;
+	s.opts = opts;
+	//One pool for all the contexts: a new one starts no threads
+	s.pool = poolCreate(threads);
+	if (s.pool == NULL)
+	{
+		fprintf(stderr, "heat2d: cannot start %d threads\n", threads);
+		return -1;
+	}
+	if (opts->affinity != NULL)
+	{
+		int *cpus = malloc(threads * sizeof(int));
+		int pinned = (cpus != NULL && affinityCpus(opts->affinity, threads, cpus) == 0 &&
+				poolPin(s.pool, cpus) == 0);
+
+		free(cpus);
+		if (!pinned)
+		{
+			fprintf(stderr, "heat2d: cannot pin the threads with --affinity=%s\n",
+					opts->affinity);
+			poolDestroy(s.pool);
+			return -1;
+		}
+	}
+	//A client that goes away must not take the server with it
+	signal(SIGPIPE, SIG_IGN);
+
+	if (strcmp(where, "-") == 0)
+		serveStream(&s, stdin, stdout);
+	else
+	{
+		int fd = serveListen(where);
+		int stop = 0;
+
+		if (fd < 0)
+		{
+			poolDestroy(s.pool);
+			return -1;
+		}
+		while (!stop)
+		{
+			int conn = accept(fd, NULL, NULL);
+			FILE *in, *out;
+
+			if (conn < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				fprintf(stderr, "heat2d: accept: %s\n", strerror(errno));
+				break;
+			}
+			in = fdopen(conn, "r");
+			out = fdopen(dup(conn), "w");
+			if (in != NULL && out != NULL)
+				stop = serveStream(&s, in, out);
+			if (in != NULL)
+				fclose(in);
+			else
+				close(conn);
+			if (out != NULL)
+				fclose(out);
+		}
+		close(fd);
+		unlink(where);
+	}
+
+	serveLatency(&s, ms);
+	fprintf(stderr, "heat2d: %d plates, latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms,"
+			" max %.3f ms; %ld contexts created, %ld reused, %ld resized\n", s.timed, ms[0],
+			ms[1], ms[2], ms[3], s.created, s.reused, s.resized);
+	for (k = 0; k < SERVE_CONTEXTS; k++)
+		heat2dDestroy(s.ctx[k].h);
+	poolDestroy(s.pool);
+	free(s.latency);
+	return 0;
+}
@@ -0,0 +1,37 @@
+/*
+ *	Server mode (--serve): a resident solver answering requests
+ *
+ *	Requests and responses are JSON objects, one per line, on stdin and
+ *	stdout (--serve=-) or on the connections to a Unix socket
+ *	(--serve=PATH, one client at a time). A request is a flat object:
+ *
+ *		{"id": 7, "M": 200, "N": 200, "Tl": 100, "Tr": 10, "Tt": 50,
+ *		 "Tb": 50, "eps": 0.0005, "format": "binary", "out": "plate.out"}
+ *
+ *	"id" (any string or number) is echoed back, "format" is "binary"
+ *	(default) or "text", and "out" names the solution file. Without "out"
+ *	the solution is sent inline: the response line says how many "bytes"
+ *	follow it, in the format of a solution file. {"cmd": "stats"} reports
+ *	the latency percentiles of the requests so far and {"cmd": "shutdown"}
+ *	stops the server, as does the end of stdin.
+ *
+ *	Every plate is solved by the threaded solvers with the options of the
+ *	command line, on one worker pool that all the contexts share. The
+ *	contexts of the last SERVE_CONTEXTS plate sizes are kept, with their
+ *	grids and scratch, and a request of one of those sizes only resets the
+ *	plate (heat2dReset): no malloc() and no pthread_create() on the way to
+ *	the solve. Once every slot is taken, a new size goes to the least
+ *	recently used context whose grids hold it (heat2dResize), so its plate
+ *	reuses their buffers; {"cmd": "stats"} counts the contexts created,
+ *	reused and resized.
+ */
+#ifndef HEAT2D_SERVE_H
+#define HEAT2D_SERVE_H
+
+#include "heat2d_options.h"
+
+#define SERVE_CONTEXTS 8
+
+int serveRun(const char *where, int threads, const Options *opts);
+
+#endif
@@ -2,93 +2,659 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <unistd.h>
 #include "heat2d_solver.h"
+#include "heat2d_kernel.h"
 /* Head2D Solver 
  *
  * Dirichlet boundary conditions 
  *
  */
-void printGrid(double **u, int M, int N);
+void printGrid(Grid *u);
+
+/* heat2dSweep
+ *	Relax rows first..last of u once. Every update reads the values of the
+ *	previous sweep, so the old contents of a row are saved before it is
+ *	overwritten.
+ *	north - row first-1 as of the previous sweep (a halo copy or a row of u)
+ *	south - row last+1 as of the previous sweep (a halo copy or a row of u)
+ *	rowPrev, rowCurr - scratch rows of N doubles
+ *	check - track the change; otherwise the update-only kernel is used
+ *
+ *	returns the largest change of any point in the rows (0 unless check)
+ */
+double heat2dSweep(Grid *u, int first, int last, const double *north,
+		const double *south, double *rowPrev, double *rowCurr, int check)
+{
+	int N = u->N;
+	int i;
+	double diff = 0.0;
+	const double *above = north;	/* old values of row i-1 */
+	double *rowTmp;
+
+	for ( i = first; i <= last; i++ )
+	{
+		double *row = GRID_ROW(u, i);
+		const double *below = (i == last) ? south : GRID_ROW(u, i+1);
+
+		/* Save the current row before it is overwritten */
+		memcpy(rowCurr, row, N*sizeof(double));
+		if (check)
+		{
+			double delta = heat2dRowKernel(row, above, below, rowCurr, N);
+			if ( diff < delta )
+			{
+				diff = delta;
+			}
+		}
+		else
+			heat2dRowUpdate(row, above, below, rowCurr, N);
+		/* the saved row becomes the north neighbour of the next one */
+		above = rowCurr;
+		rowTmp = rowPrev; rowPrev=rowCurr; rowCurr=rowTmp;
+	}
+	return diff;
+}
 
 /* heat2dSolve 
- * 	M - number of rows (input)
- * 	N - number of cols (output)
- * 	u - temperature distribution(input/output)
+ * 	u - temperature distribution, M x N (input/output)
  *	eps - tolerance
+ *	policy - when and what to check (see heat2d_converge.h), NULL checks
+ *		the change of every sweep
  *	print - print iteration information (boolean)
  *
  * 	returns
  * 	    - number of iterations
  * 	    - u contains the final temperature distribution 
 */
-int heat2dSolve(int M, int N, double eps, int print, double **u, double *tol)
+int heat2dSolve(Grid *u, double eps, const CheckPolicy *policy, int print, double *tol)
 {
 
 	int iterations = 0;
 	int iterations_print = 1;
-	int i,j;
+	int M = u->M;
 	double diff = 2.0 * eps;
 	double *rowPrev; /* copy of the previous row in u */
 	double *rowCurr; /* copy of the current row in in */
-	double *rowTmp;
+	double *rowNorm; /* residual of every row */
+	Convergence conv;
 
-	rowPrev = calloc(N, sizeof(double));
-	rowCurr = calloc(N, sizeof(double));
+	convergeInit(&conv, policy);
+	rowPrev = rowAlloc(u->N);
+	rowCurr = rowAlloc(u->N);
+	rowNorm = malloc(M * sizeof(double));
 	if (print) 
 		printf( "\n Iteration  Change\n" );
 
-	while ( eps <= diff )
+	while ( eps <= diff && !convergeStopped(&conv, iterations) )
 	{
-		/*
-			Initialize copy of "current" row 
-		*/
-		//printf ( "  %8d  %f\n", iterations, diff );
-		memcpy(rowCurr, u[0], N*sizeof(double));
+		int check = convergeDue(&conv, iterations, 1);
 		/*
 		Determine the new estimate of the solution at the interior points.
 		The new solution W is the average of north, south, east and west 
 		neighbors.  */
-		diff = 0.0;
-		for ( i = 1; i < M - 1; i++ )
+		double delta = heat2dSweep(u, 1, M - 2, GRID_ROW(u, 0), GRID_ROW(u, M-1),
+				rowPrev, rowCurr, check && conv.policy.norm == CHECK_DELTA);
+		iterations++;
+		if (!check)
+			continue;
+		diff = (conv.policy.norm == CHECK_DELTA) ? delta :
+			heat2dResidual(u, conv.policy.norm, rowNorm);
+		convergeUpdate(&conv, iterations, diff, eps);
+		if ( print && iterations >= iterations_print )
 		{
-			/* swap rowPrev and rowCurr pointers. Save the current row */
-			rowTmp = rowPrev; rowPrev=rowCurr; rowCurr=rowTmp;
-			memcpy(rowCurr, u[i], N*sizeof(double));
-	
-			for ( j = 1; j < N - 1; j++ )
+			printf ( "  %8d  %f\n", iterations, diff );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	} 
+	/* memory cleanup */
+	free(rowNorm);
+	free(rowCurr);
+	free(rowPrev);
+	*tol = diff;
+	return iterations;
+}
+
+/* heat2dSweepPingPong
+ *	One Jacobi sweep of rows first..last from src into dst. Every row reads
+ *	its neighbours straight from src, so no row is saved or copied, and
+ *	threads sweeping disjoint rows need no halo rows of each other.
+ *	geo - fixed points, sources and cutouts, relaxed with the masked
+ *		kernels on the rows they touch; NULL for a plain plate
+ *	check - track the change; otherwise the update-only kernel is used
+ *
+ *	returns the largest change of any point in the rows (0 unless check)
+ */
+double heat2dSweepPingPong(Grid *dst, const Grid *src, const Geometry *geo, int first,
+		int last, int check)
+{
+	int N = src->N;
+	int i;
+	double diff = 0.0;
+
+	for ( i = first; i <= last; i++ )
+	{
+		if (geo != NULL && !geo->plain[i])
+		{
+			if (check)
 			{
-				u[i][j] = (rowPrev[j] + u[i+1][j] + 
-					rowCurr[j-1] + rowCurr[j+1] ) / 4.0;
-	
-				double delta = fabs(rowCurr[j] - u[i][j]);
-				if ( diff < delta ) 
+				double delta = heat2dRowKernelMasked(GRID_ROW(dst, i), GRID_ROW(src, i-1),
+						GRID_ROW(src, i+1), GRID_ROW(src, i), GEO_CLASS(geo, i),
+						GEO_SOURCE_ROW(geo, i), N);
+				if ( diff < delta )
+					diff = delta;
+			}
+			else
+				heat2dRowUpdateMasked(GRID_ROW(dst, i), GRID_ROW(src, i-1),
+						GRID_ROW(src, i+1), GRID_ROW(src, i), GEO_CLASS(geo, i),
+						GEO_SOURCE_ROW(geo, i), N);
+		}
+		else if (check)
+		{
+			double delta = heat2dRowKernel(GRID_ROW(dst, i), GRID_ROW(src, i-1),
+					GRID_ROW(src, i+1), GRID_ROW(src, i), N);
+			if ( diff < delta )
+				diff = delta;
+		}
+		else
+			heat2dRowUpdate(GRID_ROW(dst, i), GRID_ROW(src, i-1), GRID_ROW(src, i+1),
+					GRID_ROW(src, i), N);
+	}
+	return diff;
+}
+
+/* heat2dSolvePingPong
+ *	heat2dSolve on two plates: every sweep reads one of u and v and writes
+ *	the other, so rows are never copied. Same iterations and the same
+ *	result as heat2dSolve.
+ *	v - second plate, the size of u; its boundary is copied from u
+ *	geo - geometry of the plate, NULL for none
+ *
+ *	returns the number of iterations; u holds the final distribution
+ */
+int heat2dSolvePingPong(Grid *u, Grid *v, const Geometry *geo, double eps,
+		const CheckPolicy *policy, int print, double *tol)
+{
+	int iterations = 0;
+	int iterations_print = 1;
+	int M = u->M;
+	int i;
+	double diff = 2.0 * eps;
+	double *rowNorm = malloc(M * sizeof(double));
+	Grid *src = u, *dst = v, *tmp;
+	Convergence conv;
+
+	for (i = 0; i < M; i++)
+		memcpy(GRID_ROW(v, i), GRID_ROW(u, i), u->N * sizeof(double));
+	convergeInit(&conv, policy);
+	if (print)
+		printf( "\n Iteration  Change\n" );
+
+	while ( eps <= diff && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+		double delta = heat2dSweepPingPong(dst, src, geo, 1, M - 2,
+				check && conv.policy.norm == CHECK_DELTA);
+
+		tmp = src; src = dst; dst = tmp;
+		iterations++;
+		if (!check)
+			continue;
+		diff = (conv.policy.norm == CHECK_DELTA) ? delta :
+			heat2dResidual(src, conv.policy.norm, rowNorm);
+		convergeUpdate(&conv, iterations, diff, eps);
+		if ( print && iterations >= iterations_print )
+		{
+			printf ( "  %8d  %f\n", iterations, diff );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	//The last sweep may have written v
+	if (src != u)
+		for (i = 1; i < M - 1; i++)
+			memcpy(GRID_ROW(u, i), GRID_ROW(src, i), u->N * sizeof(double));
+	free(rowNorm);
+	*tol = diff;
+	return iterations;
+}
+
+/* heat2dSweepRB
+ *	Over-relax the points of one colour in rows first..last of u, in place.
+ *	Point (i, j) is RED when i + j is even and BLACK otherwise; a pass over
+ *	one colour only reads the other one, so rows need no saved copies and
+ *	disjoint row ranges can be relaxed concurrently.
+ *	check - track the change; otherwise the update-only kernel is used
+ *
+ *	returns the largest change of any point in the rows (0 unless check)
+ */
+double heat2dSweepRB(Grid *u, int first, int last, int color, double omega, int check)
+{
+	int i;
+	double diff = 0.0;
+
+	for ( i = first; i <= last; i++ )
+	{
+		int j0 = ((i + 1) % 2 == color) ? 1 : 2;	/* first column of this colour */
+		if (!check)
+		{
+			heat2dRowUpdateRB(GRID_ROW(u, i), GRID_ROW(u, i-1),
+					GRID_ROW(u, i+1), j0, u->N, omega);
+			continue;
+		}
+		double delta = heat2dRowKernelRB(GRID_ROW(u, i), GRID_ROW(u, i-1),
+				GRID_ROW(u, i+1), j0, u->N, omega);
+		if ( diff < delta )
+		{
+			diff = delta;
+		}
+	}
+	return diff;
+}
+
+/* heat2dOptimalOmega
+ *	Over-relaxation factor that minimises the SOR spectral radius for the
+ *	5-point Laplacian on an M x N grid:
+ *		rho   = (cos(pi/(M-1)) + cos(pi/(N-1))) / 2   (Jacobi spectral radius)
+ *		omega = 2 / (1 + sqrt(1 - rho^2))
+ */
+double heat2dOptimalOmega(int M, int N)
+{
+	double rho = (cos(M_PI / (M - 1)) + cos(M_PI / (N - 1))) / 2.0;
+	return 2.0 / (1.0 + sqrt(1.0 - rho * rho));
+}
+
+/* heat2dSolveSOR
+ *	Red-black successive over-relaxation
+ * 	u - temperature distribution, M x N (input/output)
+ *	eps - tolerance on the largest change in one iteration (red + black)
+ *	omega - over-relaxation factor, 0 < omega < 2 (1 is Gauss-Seidel)
+ *	policy - when and what to check, NULL checks the change of every iteration
+ *	print - print iteration information (boolean)
+ *
+ * 	returns
+ * 	    - number of iterations
+ * 	    - u contains the final temperature distribution
+*/
+int heat2dSolveSOR(Grid *u, double eps, double omega, const CheckPolicy *policy,
+		int print, double *tol)
+{
+	int iterations = 0;
+	int iterations_print = 1;
+	int M = u->M;
+	double diff = 2.0 * eps;
+	double red, black;
+	double *rowNorm = malloc(M * sizeof(double));
+	Convergence conv;
+
+	convergeInit(&conv, policy);
+	if (print)
+		printf( "\n Iteration  Change\n" );
+
+	while ( eps <= diff && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+		int track = check && conv.policy.norm == CHECK_DELTA;
+
+		red = heat2dSweepRB(u, 1, M - 2, RED, omega, track);
+		black = heat2dSweepRB(u, 1, M - 2, BLACK, omega, track);
+		iterations++;
+		if (!check)
+			continue;
+		if (track)
+			diff = (red < black) ? black : red;
+		else
+			diff = heat2dResidual(u, conv.policy.norm, rowNorm);
+		convergeUpdate(&conv, iterations, diff, eps);
+		if ( print && iterations >= iterations_print )
+		{
+			printf ( "  %8d  %f\n", iterations, diff );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	free(rowNorm);
+	*tol = diff;
+	return iterations;
+}
+
+/* heat2dSweepBlocked
+ *	depth Jacobi sweeps over rows lo..hi-1 done in one pass through memory
+ *	(temporal blocking). Sweep t runs behind sweep t-1 on a skewed
+ *	wavefront: tile k covers rows [lo+1 + k*height - t, lo+1 + (k+1)*height - t)
+ *	of sweep t, so when sweep t reaches row i, row i+1 already holds the
+ *	result of sweep t-1 and rows i-1..i+1 are still in cache. Each sweep
+ *	keeps its own two saved rows, as heat2dSweep does, and the result is
+ *	identical to depth calls of heat2dSweep.
+ *
+ *	rows - rows[i - lo] is row i, lo <= i < hi
+ *	fixedTop - row lo is a Dirichlet boundary. Otherwise it (like every
+ *		row above the block) is a halo row whose values are only known for
+ *		the first sweep, so sweep t can only update rows from lo+1+t on.
+ *	fixedBot - same for row hi-1: sweep t stops at hi-2-t otherwise
+ *	height - rows per tile and sweep
+ *	scratch - 2*depth rows of N doubles
+ *	check - track the change of the last sweep; all the other sweeps use
+ *		the update-only kernel
+ *
+ *	returns the largest change made by the last sweep (0 unless check)
+ */
+double heat2dSweepBlocked(double **rows, int N, int lo, int hi, int fixedTop,
+		int fixedBot, int depth, int height, double **scratch, int check)
+{
+	int first[depth], last[depth], next[depth];
+	const double *above[depth];	/* old values of row next[t]-1 */
+	double diff = 0.0;
+	int t, k, pending;
+
+	for ( t = 0; t < depth; t++ )
+	{
+		first[t] = fixedTop ? lo + 1 : lo + 1 + t;
+		last[t] = fixedBot ? hi - 2 : hi - 2 - t;
+		next[t] = first[t];
+		above[t] = rows[first[t] - 1 - lo];
+	}
+
+	for ( k = 0, pending = 1; pending; k++ )
+	{
+		pending = 0;
+		for ( t = 0; t < depth; t++ )
+		{
+			int end = lo + 1 + (k + 1) * height - t - 1;	/* last row of tile k */
+			double *save = scratch[2*t];
+			int i;
+
+			if (end > last[t])
+				end = last[t];
+			for ( i = next[t]; i <= end; i++ )
+			{
+				double *row = rows[i - lo];
+				memcpy(save, row, N*sizeof(double));
+				if (check && t == depth - 1)
 				{
-					diff = delta; 
+					double delta = heat2dRowKernel(row, above[t], rows[i + 1 - lo], save, N);
+					if ( diff < delta )
+					{
+						diff = delta;
+					}
 				}
+				else
+					heat2dRowUpdate(row, above[t], rows[i + 1 - lo], save, N);
+				/* the saved row is the north neighbour of the next one */
+				above[t] = save;
+				save = (save == scratch[2*t]) ? scratch[2*t+1] : scratch[2*t];
+			}
+			/* keep the buffer that is not holding above[t] for the next tile */
+			if (save != scratch[2*t])
+			{
+				double *tmp = scratch[2*t];
+				scratch[2*t] = scratch[2*t+1];
+				scratch[2*t+1] = tmp;
 			}
+			if (next[t] <= end)
+				next[t] = end + 1;
+			if (next[t] <= last[t])
+				pending = 1;
 		}
-		iterations++;
-		if ( print && iterations == iterations_print )
+	}
+	return diff;
+}
+
+/* heat2dCacheL2
+ *	Size of the L2 cache in bytes, 1 MiB where the system does not tell
+ */
+long heat2dCacheL2(void)
+{
+	long l2 = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	return (l2 > 0) ? l2 : 1024 * 1024;
+}
+
+/* heat2dTileHeight
+ *	Rows per tile for heat2dSweepBlocked so that the rows in flight (a tile
+ *	plus the depth rows of the wavefront and the saved rows) take about half
+ *	of the L2 cache.
+ */
+int heat2dTileHeight(int N, int depth)
+{
+	int height;
+
+	height = (int) (heat2dCacheL2() / 2 / ((long) N * sizeof(double))) - 3 * depth;
+	return (height < 1) ? 1 : height;
+}
+
+/* heat2dSolveBlocked
+ *	heat2dSolve with temporal blocking: depth sweeps per pass through the
+ *	grid (see heat2dSweepBlocked). Convergence can only be checked at the
+ *	end of a pass, after its last sweep.
+ *	height - rows per tile, 0 picks one from the L2 cache size
+ *	policy - when and what to check, NULL checks at the end of every pass
+ *
+ * 	returns
+ * 	    - number of iterations (sweeps, a multiple of depth)
+ * 	    - u contains the final temperature distribution
+ */
+int heat2dSolveBlocked(Grid *u, double eps, int depth, int height,
+		const CheckPolicy *policy, int print, double *tol)
+{
+	int iterations = 0;
+	int iterations_print = 1;
+	int M = u->M;
+	int i;
+	double diff = 2.0 * eps;
+	double **rows = malloc(M * sizeof(double *));
+	double **scratch = malloc(2 * depth * sizeof(double *));
+	double *rowNorm = malloc(M * sizeof(double));
+	Convergence conv;
+
+	convergeInit(&conv, policy);
+	for ( i = 0; i < M; i++ )
+		rows[i] = GRID_ROW(u, i);
+	for ( i = 0; i < 2 * depth; i++ )
+		scratch[i] = rowAlloc(u->N);
+	if (height <= 0)
+		height = heat2dTileHeight(u->N, depth);
+
+	if (print)
+		printf( "\n Iteration  Change\n" );
+
+	while ( eps <= diff && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, depth);
+		double delta = heat2dSweepBlocked(rows, u->N, 0, M, 1, 1, depth, height,
+				scratch, check && conv.policy.norm == CHECK_DELTA);
+		iterations += depth;
+		if (!check)
+			continue;
+		diff = (conv.policy.norm == CHECK_DELTA) ? delta :
+			heat2dResidual(u, conv.policy.norm, rowNorm);
+		convergeUpdate(&conv, iterations, diff, eps);
+		if ( print && iterations >= iterations_print )
 		{
 			printf ( "  %8d  %f\n", iterations, diff );
-			iterations_print *= 2;
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
 		}
-	} 
+	}
 	/* memory cleanup */
+	for ( i = 0; i < 2 * depth; i++ )
+		free(scratch[i]);
+	free(scratch);
+	free(rows);
+	free(rowNorm);
+	*tol = diff;
+	return iterations;
+}
+
+/* heat2dResidual
+ *	Residual norm (CHECK_LINF or CHECK_L2) of the whole plate
+ *	rowNorm - scratch for M per-row values
+ */
+double heat2dResidual(const Grid *u, int norm, double *rowNorm)
+{
+	heat2dResidualRows(u, 1, u->M - 2, norm, rowNorm);
+	return heat2dResidualNorm(u, norm, rowNorm);
+}
+
+/* heat2dSweepF
+ *	heat2dSweep on a single precision grid, with the float row kernels
+ *
+ *	returns the largest change of any point in the rows (0 unless check)
+ */
+double heat2dSweepF(GridF *u, int first, int last, const float *north,
+		const float *south, float *rowPrev, float *rowCurr, int check)
+{
+	int N = u->N;
+	int i;
+	float diff = 0.0f;
+	const float *above = north;	/* old values of row i-1 */
+	float *rowTmp;
+
+	for ( i = first; i <= last; i++ )
+	{
+		float *row = GRIDF_ROW(u, i);
+		const float *below = (i == last) ? south : GRIDF_ROW(u, i+1);
+
+		memcpy(rowCurr, row, N*sizeof(float));
+		if (check)
+		{
+			float delta = heat2dRowKernelF(row, above, below, rowCurr, N);
+			if ( diff < delta )
+			{
+				diff = delta;
+			}
+		}
+		else
+			heat2dRowUpdateF(row, above, below, rowCurr, N);
+		above = rowCurr;
+		rowTmp = rowPrev; rowPrev=rowCurr; rowCurr=rowTmp;
+	}
+	return diff;
+}
+
+/* heat2dSolveF
+ *	heat2dSolve on a single precision grid. Only the change of a sweep
+ *	(CHECK_DELTA) can be checked.
+ *
+ * 	returns
+ * 	    - number of iterations
+ * 	    - u contains the final temperature distribution
+ */
+int heat2dSolveF(GridF *u, double eps, const CheckPolicy *policy, int print, double *tol)
+{
+	int iterations = 0;
+	int iterations_print = 1;
+	int M = u->M;
+	double diff = 2.0 * eps;
+	float *rowPrev = rowAllocF(u->N);
+	float *rowCurr = rowAllocF(u->N);
+	Convergence conv;
+
+	convergeInit(&conv, policy);
+	if (print)
+		printf( "\n Iteration  Change\n" );
+
+	while ( eps <= diff && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+		double delta = heat2dSweepF(u, 1, M - 2, GRIDF_ROW(u, 0), GRIDF_ROW(u, M-1),
+				rowPrev, rowCurr, check);
+		iterations++;
+		if (!check)
+			continue;
+		diff = delta;
+		convergeUpdate(&conv, iterations, diff, eps);
+		if ( print && iterations >= iterations_print )
+		{
+			printf ( "  %8d  %f\n", iterations, diff );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
 	free(rowCurr);
 	free(rowPrev);
 	*tol = diff;
 	return iterations;
 }
 
-void printGrid(double **u, int M, int N)
+/* heat2dFloatFloor
+ *	Smallest change a single precision sweep can reliably measure on u:
+ *	FLOAT_FLOOR_ULPS units in the last place of the largest boundary
+ *	temperature. Below it the change is rounding noise and may never reach
+ *	eps, so float sweeps stop at the floor.
+ */
+double heat2dFloatFloor(const Grid *u)
 {
+	double top = 0.0;
 	int i, j;
-	for (i = 0; i < M; i++)
+
+	for ( i = 0; i < u->M; i++ )
+	{
+		double w = fabs(GRID_ROW(u, i)[0]);
+		double e = fabs(GRID_ROW(u, i)[u->N - 1]);
+		top = (w > top) ? w : top;
+		top = (e > top) ? e : top;
+	}
+	for ( j = 0; j < u->N; j++ )
+	{
+		double n = fabs(GRID_ROW(u, 0)[j]);
+		double s = fabs(GRID_ROW(u, u->M - 1)[j]);
+		top = (n > top) ? n : top;
+		top = (s > top) ? s : top;
+	}
+	return FLOAT_FLOOR_ULPS * FLT_EPSILON * ((top > 1.0) ? top : 1.0);
+}
+
+/* heat2dSolveMixed
+ *	Jacobi iteration in reduced precision.
+ *	PRECISION_FLOAT iterates on a float copy of u until the change is below
+ *	eps (or the float floor, whichever is larger) and widens the result
+ *	back into u. PRECISION_MIXED does the same and then continues with
+ *	double sweeps on u until the change is below eps, so most sweeps move
+ *	half the bytes and the answer still meets eps in double precision.
+ *
+ * 	returns
+ * 	    - number of iterations, float and double together
+ * 	    - u contains the final temperature distribution
+ */
+int heat2dSolveMixed(Grid *u, double eps, int precision, const CheckPolicy *policy,
+		int print, double *tol)
+{
+	GridF uf;
+	double floor = heat2dFloatFloor(u);
+	double epsF = (eps > floor) ? eps : floor;
+	int iterations;
+
+	if (gridAllocF(&uf, u->M, u->N) != 0)
+		return -1;
+	gridToFloat(&uf, u, 0, u->M - 1);
+	iterations = heat2dSolveF(&uf, epsF, policy, print, tol);
+	gridToDouble(u, &uf, 0, u->M - 1);
+	gridFreeF(&uf);
+
+	if (precision == PRECISION_MIXED)
+	{
+		if (print)
+			printf ( "\n  %d float sweeps, finishing in double precision\n", iterations );
+		iterations += heat2dSolve(u, eps, policy, print, tol);
+	}
+	else if (print && epsF > eps)
+		printf ( "\n  eps is below float resolution; stopped at %G\n", epsF );
+	return iterations;
+}
+
+void printGrid(Grid *u)
+{
+	int i, j;
+	for (i = 0; i < u->M; i++)
 	{
-		for (j = 0; j < N; j++)
+		for (j = 0; j < u->N; j++)
 		{
-			printf("%6.8f ", u[i][j]);
+			printf("%6.8f ", GRID_ROW(u, i)[j]);
 		}
 		printf("\n");
 	}
@@ -1 +1,43 @@
-int heat2dSolve(int M, int N, double eps, int print, double **u, double *tol);
+#include "grid.h"
+#include "heat2d_converge.h"
+#include "heat2d_geometry.h"
+
+int heat2dSolve(Grid *u, double eps, const CheckPolicy *policy, int print, double *tol);
+double heat2dSweep(Grid *u, int first, int last, const double *north,
+		const double *south, double *rowPrev, double *rowCurr, int check);
+
+int heat2dSolvePingPong(Grid *u, Grid *v, const Geometry *geo, double eps,
+		const CheckPolicy *policy, int print, double *tol);
+double heat2dSweepPingPong(Grid *dst, const Grid *src, const Geometry *geo, int first,
+		int last, int check);
+
+int heat2dSolveBlocked(Grid *u, double eps, int depth, int height,
+		const CheckPolicy *policy, int print, double *tol);
+double heat2dSweepBlocked(double **rows, int N, int lo, int hi, int fixedTop,
+		int fixedBot, int depth, int height, double **scratch, int check);
+long heat2dCacheL2(void);
+int heat2dTileHeight(int N, int depth);
+
+#define RED 0
+#define BLACK 1
+
+int heat2dSolveSOR(Grid *u, double eps, double omega, const CheckPolicy *policy,
+		int print, double *tol);
+double heat2dSweepRB(Grid *u, int first, int last, int color, double omega, int check);
+double heat2dOptimalOmega(int M, int N);
+
+double heat2dResidual(const Grid *u, int norm, double *rowNorm);
+
+#define PRECISION_DOUBLE 0		//double storage and arithmetic throughout
+#define PRECISION_FLOAT 1		//float storage and arithmetic throughout
+#define PRECISION_MIXED 2		//float until near eps, then double sweeps
+
+/* Single precision sweeps stop here: see heat2dFloatFloor() */
+#define FLOAT_FLOOR_ULPS 16
+
+int heat2dSolveF(GridF *u, double eps, const CheckPolicy *policy, int print, double *tol);
+double heat2dSweepF(GridF *u, int first, int last, const float *north,
+		const float *south, float *rowPrev, float *rowCurr, int check);
+double heat2dFloatFloor(const Grid *u);
+int heat2dSolveMixed(Grid *u, double eps, int precision, const CheckPolicy *policy,
+		int print, double *tol);
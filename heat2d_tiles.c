@@ -0,0 +1,186 @@
+/*
+ *	2D tile decomposition of the plate interior
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "heat2d_tiles.h"
+#include "heat2d_kernel.h"
+
+/*
+ * Cut the interior of u into tiles of height x width points
+ * Return: 0 on success, -1 if memory could not be allocated
+ */
+int tilesInit(TileSet *ts, const Grid *u, int height, int width)
+{
+	int interiorM = u->M - 2;
+	int interiorN = u->N - 2;
+	int r, c, k;
+	size_t haloSize = 0;
+	double *halo;
+
+	if (interiorM < 1 || interiorN < 1)
+		interiorM = interiorN = 0;
+	ts->height = height;
+	ts->width = width;
+	ts->rows = (interiorM + height - 1) / height;
+	ts->cols = (interiorN + width - 1) / width;
+	ts->count = ts->rows * ts->cols;
+	ts->tiles = malloc((ts->count > 0 ? ts->count : 1) * sizeof(Tile));
+	if (ts->tiles == NULL)
+		return -1;
+
+	for (r = 0, k = 0; r < ts->rows; r++)
+	{
+		for (c = 0; c < ts->cols; c++, k++)
+		{
+			Tile *t = &ts->tiles[k];
+			t->i0 = 1 + r * height;
+			t->i1 = (t->i0 + height < u->M - 1) ? t->i0 + height : u->M - 1;
+			t->j0 = 1 + c * width;
+			t->j1 = (t->j0 + width < u->N - 1) ? t->j0 + width : u->N - 1;
+			t->asleep = 0;
+			haloSize += 2 * (t->j1 - t->j0 + 2) + 2 * (t->i1 - t->i0);
+		}
+	}
+
+	ts->halo = halo = malloc((haloSize > 0 ? haloSize : 1) * sizeof(double));
+	if (halo == NULL)
+	{
+		free(ts->tiles);
+		return -1;
+	}
+	for (k = 0; k < ts->count; k++)
+	{
+		Tile *t = &ts->tiles[k];
+		t->north = halo; halo += t->j1 - t->j0 + 2;
+		t->south = halo; halo += t->j1 - t->j0 + 2;
+		t->west = halo; halo += t->i1 - t->i0;
+		t->east = halo; halo += t->i1 - t->i0;
+	}
+	return 0;
+}
+
+void tilesFree(TileSet *ts)
+{
+	free(ts->tiles);
+	free(ts->halo);
+	ts->tiles = NULL;
+	ts->halo = NULL;
+}
+
+/*
+ * Copy the points around tile t into its snapshots
+ */
+void tileSnapshot(Tile *t, const Grid *u)
+{
+	int i;
+	int width = t->j1 - t->j0 + 2;
+
+	memcpy(t->north, GRID_ROW(u, t->i0 - 1) + t->j0 - 1, width * sizeof(double));
+	memcpy(t->south, GRID_ROW(u, t->i1) + t->j0 - 1, width * sizeof(double));
+	for (i = t->i0; i < t->i1; i++)
+	{
+		t->west[i - t->i0] = GRID_ROW(u, i)[t->j0 - 1];
+		t->east[i - t->i0] = GRID_ROW(u, i)[t->j1];
+	}
+}
+
+/*
+ * Largest difference between the four edges around tile t in u and its
+ * snapshots of them (the corners are not part of the stencil)
+ */
+double tileDrift(const Tile *t, const Grid *u)
+{
+	const double *north = GRID_ROW(u, t->i0 - 1);
+	const double *south = GRID_ROW(u, t->i1);
+	double drift = 0.0;
+	int i, j;
+
+	for (j = t->j0; j < t->j1; j++)
+	{
+		double d = fmax(fabs(north[j] - t->north[j - t->j0 + 1]),
+				fabs(south[j] - t->south[j - t->j0 + 1]));
+		drift = (d > drift) ? d : drift;
+	}
+	for (i = t->i0; i < t->i1; i++)
+	{
+		const double *row = GRID_ROW(u, i);
+		double d = fmax(fabs(row[t->j0 - 1] - t->west[i - t->i0]),
+				fabs(row[t->j1] - t->east[i - t->i0]));
+		drift = (d > drift) ? d : drift;
+	}
+	return drift;
+}
+
+/*
+ * One Jacobi sweep of tile t, the tile version of heat2dSweep. All the
+ * row pointers handed to the row kernel start at column j0-1, so the
+ * kernel's points 1..width-2 are the tile's columns.
+ *	rowPrev, rowCurr - scratch rows of at least j1 - j0 + 2 doubles
+ *	check - track the change; otherwise the update-only kernel is used
+ *	Return: the largest change in the tile (0 unless check)
+ */
+double tileSweep(Tile *t, Grid *u, double *rowPrev, double *rowCurr, int check)
+{
+	int width = t->j1 - t->j0 + 2;	/* tile columns plus the two edges */
+	double *save = rowCurr, *spare = rowPrev, *tmp;
+	const double *above = t->north;
+	double diff = 0.0;
+	int i;
+
+	for (i = t->i0; i < t->i1; i++)
+	{
+		double *row = GRID_ROW(u, i) + t->j0 - 1;
+		const double *below = (i == t->i1 - 1) ? t->south : GRID_ROW(u, i + 1) + t->j0 - 1;
+
+		/* Save the current row, with the neighbours' edge values around it */
+		save[0] = t->west[i - t->i0];
+		memcpy(save + 1, row + 1, (width - 2) * sizeof(double));
+		save[width - 1] = t->east[i - t->i0];
+
+		if (check)
+		{
+			double delta = heat2dRowKernel(row, above, below, save, width);
+			if (diff < delta)
+				diff = delta;
+		}
+		else
+			heat2dRowUpdate(row, above, below, save, width);
+		above = save;
+		tmp = save; save = spare; spare = tmp;
+	}
+	return diff;
+}
+
+/*
+ * Over-relax the points of one colour in tile t, in place (see
+ * heat2dSweepRB). Reads the neighbouring tiles directly, so it needs no
+ * snapshots.
+ *	Return: the largest change in the tile (0 unless check)
+ */
+double tileSweepRB(Tile *t, Grid *u, int color, double omega, int check)
+{
+	int width = t->j1 - t->j0 + 2;
+	double diff = 0.0;
+	int i;
+
+	for (i = t->i0; i < t->i1; i++)
+	{
+		/* kernel point k is column j0-1+k; find the first k of this colour */
+		int k0 = ((i + t->j0) % 2 == color) ? 1 : 2;
+		if (!check)
+		{
+			heat2dRowUpdateRB(GRID_ROW(u, i) + t->j0 - 1,
+					GRID_ROW(u, i - 1) + t->j0 - 1, GRID_ROW(u, i + 1) + t->j0 - 1,
+					k0, width, omega);
+			continue;
+		}
+		double delta = heat2dRowKernelRB(GRID_ROW(u, i) + t->j0 - 1,
+				GRID_ROW(u, i - 1) + t->j0 - 1, GRID_ROW(u, i + 1) + t->j0 - 1,
+				k0, width, omega);
+		if (diff < delta)
+			diff = delta;
+	}
+	return diff;
+}
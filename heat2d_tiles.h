@@ -0,0 +1,45 @@
+/*
+ *	2D tile decomposition of the plate interior
+ *
+ *	The interior rows 1..M-2 and columns 1..N-2 are cut into tiles of (at
+ *	most) height x width points. A Jacobi sweep of a tile reads its four
+ *	neighbouring edges from private snapshots taken before the sweep, so all
+ *	tiles can be swept in any order, by any thread, and still give exactly
+ *	the serial result.
+ *
+ *	With --sleep a tile whose sweep changed it by less than a fraction of
+ *	eps is asleep: it is not swept, and its snapshots keep the edges it was
+ *	last swept with. It wakes once any of those edges has moved by more
+ *	than the same amount (tileDrift).
+ */
+#ifndef HEAT2D_TILES_H
+#define HEAT2D_TILES_H
+
+#include "grid.h"
+
+typedef struct {
+	int i0, i1;			//rows i0..i1-1
+	int j0, j1;			//columns j0..j1-1
+	double *north;		//snapshot of row i0-1, columns j0-1..j1
+	double *south;		//snapshot of row i1, columns j0-1..j1
+	double *west;		//snapshot of column j0-1, rows i0..i1-1
+	double *east;		//snapshot of column j1, rows i0..i1-1
+	int asleep;			//skipped by the sweeps (--sleep)
+} Tile;
+
+typedef struct {
+	int count;			//number of tiles
+	int rows, cols;		//tiles per column and per row of the plate
+	int height, width;	//nominal tile size
+	Tile *tiles;		//row-major
+	double *halo;		//storage of all the snapshots
+} TileSet;
+
+int tilesInit(TileSet *ts, const Grid *u, int height, int width);
+void tilesFree(TileSet *ts);
+void tileSnapshot(Tile *t, const Grid *u);
+double tileDrift(const Tile *t, const Grid *u);
+double tileSweep(Tile *t, Grid *u, double *rowPrev, double *rowCurr, int check);
+double tileSweepRB(Tile *t, Grid *u, int color, double omega, int check);
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ *	Per-thread phase timing of the threaded solvers (--trace)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "heat2d_trace.h"
+
+static const char *phaseName[TRACE_PHASES] = { "compute", "halo", "barrier", "check" };
+
+static double traceWall(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Clock ticks per second, measured from traceInit() until now
+ */
+static double traceRate(const Trace *t)
+{
+	double wall = traceWall() - t->wall0;
+	unsigned long long ticks = traceClock() - t->tsc0;
+
+	if (wall <= 0 || ticks == 0)
+		return 1e9;
+	return ticks / wall;
+}
+
+/*
+ * Set up a trace for threads workers; with events the phases are also kept
+ * for traceWrite()
+ * Return: 0, -1 if out of memory
+ */
+int traceInit(Trace *t, int threads, int events)
+{
+	int r;
+
+	memset(t, 0, sizeof(*t));
+	t->threads = threads;
+	t->thread = calloc(threads, sizeof(TraceThread));
+	if (t->thread == NULL)
+		return -1;
+	for (r = 0; r < threads && events; r++)
+	{
+		t->thread[r].events = malloc(TRACE_MAX_EVENTS * sizeof(TraceEvent));
+		if (t->thread[r].events == NULL)
+			return -1;
+	}
+	t->wall0 = traceWall();
+	t->tsc0 = traceClock();
+	return 0;
+}
+
+/*
+ * Thread rank begins a solve: its first phase starts now
+ */
+void traceStart(Trace *t, int rank)
+{
+	TraceThread *th;
+
+	if (t == NULL)
+		return;
+	th = &t->thread[rank];
+	th->compute[0] = th->compute[1] = 0;
+	th->parity = 0;
+	th->iterations = 0;
+	th->mark = traceClock();
+}
+
+/*
+ * Rank 0: add the load imbalance of the iteration that used slot parity.
+ * Every thread has passed the barrier that ended that iteration, so its
+ * compute time there is final; the threads already work in the other slot.
+ */
+static void traceImbalance(Trace *t, int parity)
+{
+	unsigned long long max = 0, sum = 0;
+	double imbalance;
+	int r;
+
+	for (r = 0; r < t->threads; r++)
+	{
+		unsigned long long c = t->thread[r].compute[parity];
+		sum += c;
+		max = (c > max) ? c : max;
+	}
+	if (sum == 0)
+		return;
+	imbalance = (double) max * t->threads / sum;
+	t->imbalanceSum += imbalance;
+	t->imbalanceMax = (imbalance > t->imbalanceMax) ? imbalance : t->imbalanceMax;
+	t->imbalanceCount++;
+}
+
+/*
+ * Thread rank begins an iteration (after the barrier that ended the last)
+ */
+void traceIteration(Trace *t, int rank)
+{
+	TraceThread *th;
+
+	if (t == NULL)
+		return;
+	th = &t->thread[rank];
+	if (rank == 0 && th->iterations > 0)
+		traceImbalance(t, th->parity);
+	th->parity = 1 - th->parity;
+	th->compute[th->parity] = 0;
+	th->iterations++;
+}
+
+/*
+ * Thread rank has left its solve loop; the last iteration ended with a
+ * barrier, so rank 0 can still measure it
+ */
+void traceStop(Trace *t, int rank)
+{
+	if (t == NULL)
+		return;
+	if (rank == 0 && t->thread[0].iterations > 0)
+		traceImbalance(t, t->thread[0].parity);
+	t->thread[rank].iterations = 0;
+}
+
+/*
+ * Print the share of every phase per thread and the load imbalance
+ */
+void traceReport(const Trace *t, FILE *fp)
+{
+	double rate = traceRate(t);
+	int r, p;
+
+	fprintf(fp, "\n  Thread");
+	for (p = 0; p < TRACE_PHASES; p++)
+		fprintf(fp, "  %9s", phaseName[p]);
+	fprintf(fp, "  Total (ms)\n");
+	for (r = 0; r < t->threads; r++)
+	{
+		const TraceThread *th = &t->thread[r];
+		unsigned long long total = 0;
+
+		for (p = 0; p < TRACE_PHASES; p++)
+			total += th->ticks[p];
+		fprintf(fp, "  %6d", r);
+		for (p = 0; p < TRACE_PHASES; p++)
+			fprintf(fp, "  %8.1f%%", (total > 0) ? 100.0 * th->ticks[p] / total : 0.0);
+		fprintf(fp, "  %10.2f\n", 1e3 * total / rate);
+	}
+	if (t->imbalanceCount > 0)
+		fprintf(fp, "  Load imbalance (max / mean compute): %.3f on average, %.3f at worst,"
+				" over %ld iterations\n", t->imbalanceSum / t->imbalanceCount,
+				t->imbalanceMax, t->imbalanceCount);
+}
+
+/*
+ * Write the kept phases to path as Chrome trace JSON, one track per thread
+ * Return: 0, -1 if the file could not be written
+ */
+int traceWrite(const Trace *t, const char *path)
+{
+	FILE *fp = fopen(path, "w");
+	double usPerTick = 1e6 / traceRate(t);
+	const char *sep = "";
+	long dropped = 0;
+	int r, k;
+
+	if (fp == NULL)
+		return -1;
+	fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	for (r = 0; r < t->threads; r++)
+	{
+		const TraceThread *th = &t->thread[r];
+
+		fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+				"\"args\": {\"name\": \"worker %d\"}}", sep, r, r);
+		sep = ",\n";
+		for (k = 0; k < th->count; k++)
+		{
+			const TraceEvent *e = &th->events[k];
+			fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+					"\"ts\": %.3f, \"dur\": %.3f}", phaseName[e->phase], r,
+					(e->start - t->tsc0) * usPerTick, (e->end - e->start) * usPerTick);
+		}
+		dropped += th->dropped;
+	}
+	fprintf(fp, "\n]}\n");
+	if (dropped > 0)
+		fprintf(stderr, "heat2d: %ld trace events beyond %d per thread were not kept\n",
+				dropped, TRACE_MAX_EVENTS);
+	return (ferror(fp) || fclose(fp) != 0) ? -1 : 0;
+}
+
+void traceFree(Trace *t)
+{
+	int r;
+
+	if (t->thread == NULL)
+		return;
+	for (r = 0; r < t->threads; r++)
+		free(t->thread[r].events);
+	free(t->thread);
+	t->thread = NULL;
+}
@@ -0,0 +1,126 @@
+/*
+ *	Per-thread phase timing of the threaded solvers (--trace)
+ *
+ *	Every worker splits its time into
+ *
+ *	compute - stencil sweeps of its rows or tiles
+ *	halo - copying the neighbours' rows (tile edges) before a sweep
+ *	barrier - waiting for the other threads, including the max reduction
+ *	check - residual rows and checkpoint copies of a checked iteration
+ *
+ *	The solver calls traceMark() at the end of each phase: the time since
+ *	the previous mark goes to that phase, so the phases add up to the whole
+ *	solve. Time is read from the cycle counter (TSC) and converted with the
+ *	rate measured against the wall clock over the whole trace.
+ *
+ *	At every iteration rank 0 also compares the compute time of the threads
+ *	in the iteration before: max / mean is the load imbalance (1.0 when all
+ *	of them did the same work in the same time).
+ *
+ *	With a trace file every phase is also kept as an event, written out as
+ *	Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Events beyond
+ *	TRACE_MAX_EVENTS per thread are counted but not kept.
+ *
+ *	The solvers pass a NULL Trace when tracing is off; every call then
+ *	returns at once.
+ */
+#ifndef HEAT2D_TRACE_H
+#define HEAT2D_TRACE_H
+
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define PHASE_COMPUTE 0
+#define PHASE_HALO 1
+#define PHASE_BARRIER 2
+#define PHASE_CHECK 3
+#define TRACE_PHASES 4
+
+#define TRACE_MAX_EVENTS (1 << 20)
+#define TRACE_LINE 64
+
+typedef struct {
+	unsigned long long start;
+	unsigned long long end;
+	int phase;
+} TraceEvent;
+
+typedef struct {
+	unsigned long long ticks[TRACE_PHASES];	//total per phase
+	unsigned long long mark;				//end of the previous phase
+	unsigned long long compute[2];			//compute ticks of this iteration and the last
+	int parity;								//slot of compute[] this iteration uses
+	int iterations;							//iterations begun in this solve
+	TraceEvent *events;						//NULL = no trace file
+	int count;
+	long dropped;
+	char pad[TRACE_LINE];					//keeps the next thread's counters off this line
+} TraceThread;
+
+typedef struct {
+	int threads;
+	TraceThread *thread;
+	unsigned long long tsc0;	//cycle counter and wall clock at traceInit()
+	double wall0;
+	double imbalanceSum;		//sum of max / mean over the iterations measured
+	double imbalanceMax;
+	long imbalanceCount;
+} Trace;
+
+/*
+ * Cycle counter, or nanoseconds where there is none
+ */
+static inline unsigned long long traceClock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/*
+ * End the current phase of thread rank: the time since its previous mark
+ * goes to phase
+ */
+static inline void traceMark(Trace *t, int rank, int phase)
+{
+	TraceThread *th;
+	unsigned long long now;
+
+	if (t == NULL)
+		return;
+	th = &t->thread[rank];
+	now = traceClock();
+	th->ticks[phase] += now - th->mark;
+	if (phase == PHASE_COMPUTE)
+		th->compute[th->parity] += now - th->mark;
+	if (th->events != NULL)
+	{
+		if (th->count < TRACE_MAX_EVENTS)
+		{
+			th->events[th->count].start = th->mark;
+			th->events[th->count].end = now;
+			th->events[th->count].phase = phase;
+			th->count++;
+		}
+		else
+			th->dropped++;
+	}
+	th->mark = now;
+}
+
+int traceInit(Trace *t, int threads, int events);
+void traceStart(Trace *t, int rank);
+void traceIteration(Trace *t, int rank);
+void traceStop(Trace *t, int rank);
+void traceReport(const Trace *t, FILE *fp);
+int traceWrite(const Trace *t, const char *path);
+void traceFree(Trace *t);
+
+#endif
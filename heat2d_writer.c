@@ -0,0 +1,146 @@
+/*
+ *	Background solution writer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heat2d_writer.h"
+
+void writerInit(GridWriter *w)
+{
+	memset(w, 0, sizeof(*w));
+	w->snapshot.data = NULL;
+}
+
+static void *writerMain(void *arg)
+{
+	GridWriter *w = (GridWriter *) arg;
+	w->status = gridWriteFile(w->path, &w->snapshot, &w->info, w->format);
+	__atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/*
+ * Whether a file is still being written. Never blocks; a finished write is
+ * reaped, so afterwards the snapshot can be reused.
+ */
+int writerBusy(GridWriter *w)
+{
+	if (!w->active)
+		return 0;
+	if (!__atomic_load_n(&w->done, __ATOMIC_ACQUIRE))
+		return 1;
+	writerWait(w);
+	return 0;
+}
+
+/*
+ * The snapshot, sized M x N, for the caller to fill. The writer must not
+ * be busy.
+ * Return: the snapshot, or NULL if it could not be allocated
+ */
+Grid *writerBuffer(GridWriter *w, int M, int N)
+{
+	//Keep the snapshot between files of the same size
+	if (w->snapshot.data != NULL && (w->snapshot.M != M || w->snapshot.N != N))
+		gridFree(&w->snapshot);
+	if (w->snapshot.data == NULL && gridAlloc(&w->snapshot, M, N) != 0)
+		return NULL;
+	return &w->snapshot;
+}
+
+/*
+ * Start writing the filled snapshot to path in the background
+ * Return: 0 if the write was started, -1 otherwise
+ */
+int writerCommit(GridWriter *w, const char *path, const GridInfo *info, int format)
+{
+	free(w->path);
+	w->path = strdup(path);
+	w->info = *info;
+	w->format = format;
+	w->status = 0;
+	w->done = 0;
+	if (w->path == NULL || pthread_create(&w->thread, NULL, writerMain, w) != 0)
+		return -1;
+	w->active = 1;
+	return 0;
+}
+
+/*
+ * Snapshot u and write it to path in the background
+ * Return: 0 if the write was started, -1 if the snapshot could not be
+ * allocated or the thread not started (nothing is written then)
+ */
+int writerStart(GridWriter *w, const char *path, const Grid *u,
+		const GridInfo *info, int format)
+{
+	Grid *snap;
+	int i;
+
+	writerWait(w);
+	snap = writerBuffer(w, u->M, u->N);
+	if (snap == NULL)
+		return -1;
+	for (i = 0; i < u->M; i++)
+		memcpy(GRID_ROW(snap, i), GRID_ROW(u, i), u->N * sizeof(double));
+	return writerCommit(w, path, info, format);
+}
+
+/*
+ * Wait for the file being written, if any
+ * Return: 0, or -1 if it could not be written
+ */
+int writerWait(GridWriter *w)
+{
+	if (w->active)
+	{
+		pthread_join(w->thread, NULL);
+		w->active = 0;
+	}
+	return w->status;
+}
+
+void writerFree(GridWriter *w)
+{
+	writerWait(w);
+	gridFree(&w->snapshot);
+	free(w->path);
+	w->path = NULL;
+}
+
+/*
+ * Name of checkpoint slot 0 or 1
+ */
+void checkpointPath(char *out, size_t size, const char *base, int slot)
+{
+	snprintf(out, size, "%s.%d", base, slot);
+}
+
+/*
+ * Load the newest complete checkpoint slot of base into u (which has the
+ * plate's size). base may also name a binary solution file itself.
+ * Return: the slot loaded (0 or 1, 2 for base itself), -1 if there is no
+ * usable file of u's size
+ */
+int checkpointLoad(const char *base, Grid *u, GridInfo *info)
+{
+	char path[2][4096];
+	GridHeader h;
+	int best = -1, bestIter = -1;
+	int slot;
+
+	for (slot = 0; slot < 2; slot++)
+	{
+		checkpointPath(path[slot], sizeof(path[slot]), base, slot);
+		if (gridReadHeader(path[slot], &h) == 0 && h.M == u->M && h.N == u->N &&
+				h.iterations > bestIter)
+		{
+			best = slot;
+			bestIter = h.iterations;
+		}
+	}
+	if (best >= 0 && gridReadBinary(path[best], u, info) == 0)
+		return best;
+	return (gridReadBinary(base, u, info) == 0) ? 2 : -1;
+}
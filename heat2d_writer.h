@@ -0,0 +1,46 @@
+/*
+ *	Background solution writer
+ *
+ *	writerStart() copies the grid into a private snapshot and returns right
+ *	away; a thread of its own then writes the snapshot to the file while
+ *	the caller goes on with its next job (and may change the grid).
+ *	writerWait() waits for the file to be complete. A writer handles one
+ *	file at a time: starting a new one first waits for the previous one.
+ *
+ *	Threads that want to fill the snapshot themselves (each copying its own
+ *	rows) use writerBusy() / writerBuffer() / writerCommit() instead.
+ *
+ *	Checkpoints go to two slot files, base.0 and base.1, written in turn
+ *	with GRID_FORMAT_CHECKPOINT; a crash while one is written leaves the
+ *	other one intact. checkpointLoad() picks the newest complete slot.
+ */
+#ifndef HEAT2D_WRITER_H
+#define HEAT2D_WRITER_H
+
+#include <pthread.h>
+#include "grid.h"
+
+typedef struct {
+	pthread_t thread;
+	int active;			//a write was started and not waited for
+	int done;			//set by the writer thread when the file is written
+	Grid snapshot;
+	GridInfo info;
+	char *path;
+	int format;			//GRID_FORMAT_BINARY, _TEXT or _CHECKPOINT
+	int status;			//0, or -1 if the last file could not be written
+} GridWriter;
+
+void writerInit(GridWriter *w);
+int writerStart(GridWriter *w, const char *path, const Grid *u,
+		const GridInfo *info, int format);
+int writerBusy(GridWriter *w);
+Grid *writerBuffer(GridWriter *w, int M, int N);
+int writerCommit(GridWriter *w, const char *path, const GridInfo *info, int format);
+int writerWait(GridWriter *w);
+void writerFree(GridWriter *w);
+
+void checkpointPath(char *out, size_t size, const char *base, int slot);
+int checkpointLoad(const char *base, Grid *u, GridInfo *info);
+
+#endif
@@ -1,6 +1,7 @@
 #! /usr/bin/env python
 # small script to create colored 2D heatmaps from an output file
 # generated by heat2d.c
+import struct
 import numpy as np
 import matplotlib as mpl
 mpl.use('Agg')
@@ -12,25 +13,37 @@ if len(sys.argv) != 2:
 	print("Usage: heatmap <inputfile>")
 	sys.exit(-1)
 
+# Binary solution file: see GridHeader in grid.h
+MAGIC = b'HEAT2DB\0'
+HEADER = struct.Struct('=8sIIIiii5d')
+DTYPES = {1: np.float64}
+
+def load(fname):
+	"""The solution as an M x N array; binary files are memory mapped"""
+	with open(fname, 'rb') as f:
+		head = f.read(HEADER.size)
+	if head[:8] != MAGIC:
+		# text format: M, N, then one line per row
+		return np.loadtxt(fname, skiprows=2, ndmin=2)
+	magic, version, headerSize, dtype, M, N, iters, Tl, Tr, Tt, Tb, tol = HEADER.unpack(head)
+	if dtype not in DTYPES:
+		print("%s: unknown dtype %d" % (fname, dtype))
+		sys.exit(-1)
+	return np.memmap(fname, dtype=DTYPES[dtype], mode='r', offset=headerSize, shape=(M, N))
+
 fname = sys.argv[1]
-f = open(fname)
 outfile = fname.split('.')[0] + ".png"
-M = int(f.readline().strip())
-N = int(f.readline().strip())
-data = []
-for l in f.readlines():
-	data.append(map(lambda x: float(x),l.strip().split()))
+npA = load(fname)
 
-npA = np.array(data)
 # range the entries to be 0 .. 100
 # offset
 minv = npA.min()
-npA -= minv
 # scale
-maxv = npA.max()
-npA *= (100/maxv)
+maxv = npA.max() - minv
+if maxv == 0:
+	maxv = 1.0
 # Create plot
 fig = plt.figure()
-plt.imshow(npA,cmap=colormap)
+plt.imshow((npA - minv) * (100/maxv),cmap=colormap)
 plt.show()
 plt.savefig(outfile)
@@ -0,0 +1,1802 @@
+/*
+ *	libheat2d: the plate solvers behind one reentrant interface
+ *
+ *	The threaded solvers started out in heat2dPara.c with the plate, the
+ *	barrier and the per-thread parameters in globals. They now take all of
+ *	it from the Heat2d context, which is the argument of every pool job.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include "libheat2d.h"
+#include "heat2d_solver.h"
+#include "heat2d_kernel.h"
+#include "barrier.h"
+#include "threadpool.h"
+#include "heat2d_tiles.h"
+#include "multigrid.h"
+#include "heat2d_pcg.h"
+#include "heat2d_writer.h"
+#include "heat2d_init.h"
+#include "heat2d_geometry.h"
+#include "affinity.h"
+#include "heat2d_trace.h"
+
+#define TOP 0
+#define MID 1
+#define BOT 2
+#define WHOLE 3
+
+//What one worker of the pool works on, and what it reports back
+typedef struct {
+	int rank;
+	int position;	//TOP, MID, BOT or WHOLE
+	int copyStart;	//rows copyStart..copyEnd-1 of the plate are its strip
+	int copyEnd;
+	int sense;		//local sense for bar, kept from one job to the next
+	int iter;		//iteration count at the end of the job
+	double tol;		//measure at the end of the job
+	long swept;		//tile sweeps of the job ...
+	long slept;		//... that found the tile asleep (--sleep)
+} Param;
+
+//Where a worker runs and where the pages of its part of the plate are
+typedef struct {
+	int cpu;
+	int node;
+	int known;		//0 if the kernel cannot tell page nodes
+	PageCount pages;
+} Placement;
+
+//Arguments of the findPlacement pool job
+typedef struct {
+	struct Heat2d *h;
+	Placement *placement;	//one per worker
+} PlacementJob;
+
+struct Heat2d {
+	Heat2dConfig cfg;
+	int M, N;
+	int threads;			//0 = serial solvers
+	Grid u;
+	size_t room;			//bytes of the buffers of u and v (heat2dResize)
+	CheckPolicy policy;		//policy of the current run or step
+	int iterations;			//done so far
+	double change;			//measure at the last check
+	Geometry geo;			//fixed points, sources and cutouts (--geometry)
+	const Geometry *geoSweep;	//&geo, NULL without --geometry
+	int pingPong;			//ping-pong Jacobi (--jacobi) ...
+	Grid v;					//... from u into v and back
+	int hasBasis;			//heat2dBasis() has solved ...
+	Grid basis[4];			//... the plate with 1 on the left, right, top or bottom edge
+	double basisTol[4];		//and the final measure of each
+
+	//Threaded solvers
+	ThreadPool *pool;
+	Param *param;			//one per worker
+	Barrier bar;			//shared by the workers, also reduces the max change
+	double *rowNorm;		//per-row residuals of a residual check
+	double globalDiff;		//measure at the end of a job, set by rank 0
+	int startIterations;	//iteration count a job starts from
+
+	//Tile decomposition (--tile) and the queues of its two phases
+	int useTiles;
+	TileSet tiles;
+	TaskQueue phaseQueue[2];
+
+	//Level hierarchy of --method=mg
+	int useMG;
+	Multigrid mg;
+
+	//Vectors of --method=cg
+	int useCG;
+	Pcg cg;
+
+	//Single precision copy of the plate (--precision=float|mixed), and the
+	//tolerance its sweeps stop at
+	GridF uf;
+	double floatEps;
+
+	//Periodic checkpoints (--checkpoint), written by ckWriter in the background
+	GridWriter ckWriter;
+	GridInfo ckInfo;		//boundary temperatures of the plate
+	const char *ckBase;		//NULL = no checkpoints
+	int ckEvery;
+	int ckSlot;				//slot the next checkpoint goes to
+	int ckTake;				//set by rank 0: copy the plate at the end of this iteration
+	Grid *ckSnap;			//the writer's snapshot, filled by all threads
+
+	//Background solution writes (--async-write)
+	GridWriter writer;
+
+	//Phase timing of the workers (--trace), NULL = off
+	Trace *trace;
+	Trace traceData;
+};
+
+//Arguments of the writeRows pool job
+typedef struct {
+	Heat2d *h;
+	int fd;
+	size_t offset;	/* where row 0 starts */
+	int *status;	/* per worker: 0 or -1 */
+} TextJob;
+
+void heat2dConfigDefault(Heat2dConfig *cfg)
+{
+	cfg->M = cfg->N = 0;
+	cfg->Tl = cfg->Tr = cfg->Tt = cfg->Tb = 0.0;
+	cfg->eps = 0.0;
+	cfg->threads = 0;
+	cfg->pool = NULL;
+	cfg->print = 0;
+	optionsDefault(&cfg->opts);
+}
+
+/*
+ *	Cut the rows of the plate into one strip per worker
+ */
+static void splitStrips(Heat2d *h)
+{
+	int start = 0;
+	int end = 0;
+	int step = (int) ceil( (double) h->M / (double) h->threads);
+	int thread;
+
+	for (thread = 0; thread < h->threads; thread++)
+	{
+		Param *param = &h->param[thread];
+		param->rank = thread;
+		param->sense = 0;
+
+		//Determine the position
+		start = end;
+		end += step;
+		if (h->threads == 1)
+		{
+			param->position = WHOLE;
+			start = 0;
+			end = h->M;
+		}
+		else if (start == 0)
+			param->position = TOP;
+		//if we went pass the end, then this is the bottom piece
+		if (start != 0 && end >= h->M)
+		{
+			end = h->M;
+			param->position = BOT;
+		}
+		else if (start != 0)
+			param->position = MID;
+
+		param->copyStart = start;
+		param->copyEnd = end;
+	}
+}
+
+/*
+ *	Block k of the plate that worker rank sweeps: its strip, or the k-th tile
+ *	of its slice of the tile queues (edge tiles take the boundary next to
+ *	them along)
+ *	Return: 0, -1 when rank has no block k
+ */
+static int plateBlock(Heat2d *h, int rank, int k, int *i0, int *i1, int *j0, int *j1)
+{
+	if (!h->useTiles)
+	{
+		if (k > 0)
+			return -1;
+		*i0 = h->param[rank].copyStart;
+		*i1 = h->param[rank].copyEnd;
+		*j0 = 0;
+		*j1 = h->N;
+		return 0;
+	}
+	if (h->tiles.count == 0)
+	{
+		//No interior: the boundary belongs to rank 0
+		if (k > 0 || rank > 0)
+			return -1;
+		*i0 = 0;
+		*i1 = h->M;
+		*j0 = 0;
+		*j1 = h->N;
+		return 0;
+	}
+
+	int first = (int) ((long) h->tiles.count * rank / h->threads);
+	int end = (int) ((long) h->tiles.count * (rank + 1) / h->threads);
+	Tile *t;
+
+	if (first + k >= end)
+		return -1;
+	t = &h->tiles.tiles[first + k];
+	*i0 = (t->i0 == 1) ? 0 : t->i0;
+	*i1 = (t->i1 == h->M - 1) ? h->M : t->i1;
+	*j0 = (t->j0 == 1) ? 0 : t->j0;
+	*j1 = (t->j1 == h->N - 1) ? h->N : t->j1;
+	return 0;
+}
+
+/*
+ *	Pool job: initialize this worker's part of the plate, so its pages are
+ *	first touched, and placed, on the worker's NUMA node
+ */
+static void touchPlate(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	Heat2dConfig *cfg = &h->cfg;
+	double mean = plateMean(&h->u, cfg->Tl, cfg->Tr, cfg->Tt, cfg->Tb);
+	int i0, i1, j0, j1;
+	int k;
+
+	for (k = 0; plateBlock(h, rank, k, &i0, &i1, &j0, &j1) == 0; k++)
+		plateFill(&h->u, i0, i1, j0, j1, cfg->Tl, cfg->Tr, cfg->Tt, cfg->Tb, mean);
+}
+
+/*
+ *	Pool job of printPlacement(): locate this worker and its pages
+ */
+static void findPlacement(void *arg, int rank)
+{
+	PlacementJob *job = (PlacementJob *) arg;
+	Heat2d *h = job->h;
+	Placement *p = &job->placement[rank];
+	long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long base = (unsigned long) h->u.data / pageSize;
+	size_t pages = ((unsigned long) GRID_ROW(&h->u, h->M) - 1) / pageSize - base + 1;
+	char *seen;
+	int i0, i1, j0, j1;
+	int i, k;
+	size_t page, end;
+
+	p->cpu = sched_getcpu();
+	p->node = cpuNode(p->cpu);
+	p->known = 1;
+	if (!h->useTiles)
+	{
+		plateBlock(h, rank, 0, &i0, &i1, &j0, &j1);
+		if (i0 < i1)
+			p->known = (pageNodes(GRID_ROW(&h->u, i0),
+						(size_t) (i1 - i0) * h->u.stride * sizeof(double),
+						p->node, &p->pages) == 0);
+		return;
+	}
+	//Tiles share pages with the rows above and below and with the tiles
+	//beside them: mark the pages of the worker first, then count each once
+	seen = calloc(pages, 1);
+	if (seen == NULL)
+	{
+		p->known = 0;
+		return;
+	}
+	for (k = 0; plateBlock(h, rank, k, &i0, &i1, &j0, &j1) == 0; k++)
+		for (i = i0; i < i1; i++)
+		{
+			unsigned long first = (unsigned long) (GRID_ROW(&h->u, i) + j0) / pageSize;
+			unsigned long last = (unsigned long) (GRID_ROW(&h->u, i) + j1) - 1;
+
+			for (last /= pageSize; first <= last; first++)
+				seen[first - base] = 1;
+		}
+	for (page = 0; page < pages && p->known; page = end)
+	{
+		for (end = page; end < pages && seen[end]; end++)
+			;
+		if (end > page)
+			p->known = (pageNodes((void *) ((base + page) * pageSize),
+						(end - page) * pageSize, p->node, &p->pages) == 0);
+		else
+			end++;
+	}
+	free(seen);
+}
+
+/*
+ *	Print the CPU and NUMA node of every worker, and how many pages of its
+ *	part of the plate are on the same node
+ */
+static void printPlacement(Heat2d *h)
+{
+	PlacementJob job;
+	int rank;
+
+	job.h = h;
+	job.placement = calloc(h->threads, sizeof(Placement));
+	if (job.placement == NULL)
+		return;
+	poolRun(h->pool, findPlacement, &job);
+	printf("  Placement:\n");
+	printf("    thread   cpu  node   local pages  remote pages  untouched\n");
+	for (rank = 0; rank < h->threads; rank++)
+	{
+		Placement *p = &job.placement[rank];
+		if (p->known)
+			printf("    %6d  %4d  %4d  %12ld  %12ld  %9ld\n", rank, p->cpu, p->node,
+					p->pages.local, p->pages.remote, p->pages.absent);
+		else
+			printf("    %6d  %4d  %4d  %12s  %12s  %9s\n", rank, p->cpu, p->node,
+					"-", "-", "-");
+	}
+	free(job.placement);
+}
+
+/*
+ *	Pool job of writeTextPara(): format and write this worker's rows
+ */
+static void writeRows(void *arg, int rank)
+{
+	TextJob *job = (TextJob *) arg;
+	Heat2d *h = job->h;
+	int first = (int) ((long) h->M * rank / h->threads);
+	int last = (int) ((long) h->M * (rank + 1) / h->threads) - 1;
+
+	job->status[rank] = 0;
+	if (first <= last)
+		job->status[rank] = gridWriteTextRows(job->fd, &h->u, first, last, job->offset);
+}
+
+/*
+ *	Write the plate in the text format with every worker of the pool: the
+ *	rows all have the same length, so each worker formats its share of them
+ *	into its own buffer and writes it at its offset in the file. If some
+ *	value is too wide for the fixed layout the file is written again with
+ *	gridWriteText.
+ *	Return: 0, or -1 if the file could not be written
+ */
+static int writeTextPara(Heat2d *h, const char *path)
+{
+	char header[32];
+	int length = gridTextHeader(header, sizeof(header), &h->u);
+	int *status = malloc(h->threads * sizeof(int));
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	int result = 0;
+	int i;
+	TextJob job;
+
+	if (fd < 0 || status == NULL)
+	{
+		if (fd >= 0)
+			close(fd);
+		free(status);
+		return -1;
+	}
+	if (write(fd, header, length) != length)
+		result = -1;
+	job.h = h;
+	job.fd = fd;
+	job.offset = length;
+	job.status = status;
+	if (result == 0)
+		poolRun(h->pool, writeRows, &job);
+	for (i = 0; i < h->threads && result == 0; i++)
+		result = status[i];
+	if (close(fd) != 0)
+		result = -1;
+	free(status);
+
+	if (result != 0)
+	{
+		//Fall back to the plain writer
+		FILE *fp = fopen(path, "w");
+		if (fp == NULL)
+			return -1;
+		gridWriteText(fp, &h->u);
+		result = (ferror(fp) || fclose(fp) != 0) ? -1 : 0;
+	}
+	return result;
+}
+
+/*
+ *	End of an iteration that is checked for convergence. For CHECK_DELTA
+ *	the threads combine their max changes; for a residual norm every thread
+ *	computes the residual of rows first..last once all rows are updated, and
+ *	all of them combine the rows in the same order.
+ *	Return: the measure for the whole plate (the same in every thread)
+ */
+static double checkPara(Heat2d *h, const Grid *u, int rank, int norm, int *sense, int first,
+		int last, double diff)
+{
+	double global;
+
+	if (norm == CHECK_DELTA)
+	{
+		global = barrierReduceMax(&h->bar, sense, diff);
+		traceMark(h->trace, rank, PHASE_BARRIER);
+		return global;
+	}
+	barrierWait(&h->bar, sense);
+	traceMark(h->trace, rank, PHASE_BARRIER);
+	if (first <= last)
+		heat2dResidualRows(u, first, last, norm, h->rowNorm);
+	traceMark(h->trace, rank, PHASE_CHECK);
+	barrierWait(&h->bar, sense);
+	traceMark(h->trace, rank, PHASE_BARRIER);
+	global = heat2dResidualNorm(u, norm, h->rowNorm);
+	traceMark(h->trace, rank, PHASE_CHECK);
+	return global;
+}
+
+/*
+ *	Rank 0, before the barrier that ends an iteration: decide whether the
+ *	threads copy the plate for a checkpoint once it is over. They don't if
+ *	the previous checkpoint is still being written; the workers never wait
+ *	for the disk, the checkpoint just comes at the next checked iteration.
+ */
+static void checkpointDecide(Heat2d *h, int iterations, int next)
+{
+	h->ckTake = 0;
+	h->ckSnap = NULL;
+	if (h->ckBase == NULL || iterations < next || writerBusy(&h->ckWriter))
+		return;
+	h->ckSnap = writerBuffer(&h->ckWriter, h->M, h->N);
+	h->ckTake = (h->ckSnap != NULL);
+}
+
+/*
+ *	Every thread, after the barrier that ended a checked iteration: if rank
+ *	0 decided on a checkpoint, copy this thread's share of the rows of u
+ *	(the plate as of that iteration) into the snapshot; once all are in,
+ *	rank 0 hands it to the background writer.
+ *	next - iteration count at which the next checkpoint is due (updated)
+ */
+static void checkpointPara(Heat2d *h, const Grid *u, int rank, int *sense, int iterations,
+		double global, int *next)
+{
+	int first = (int) ((long) h->M * rank / h->threads);
+	int end = (int) ((long) h->M * (rank + 1) / h->threads);
+	int i;
+
+	if (h->ckBase == NULL || iterations < *next || !h->ckTake)
+		return;
+	for (i = first; i < end; i++)
+		memcpy(GRID_ROW(h->ckSnap, i), GRID_ROW(u, i), h->N * sizeof(double));
+	traceMark(h->trace, rank, PHASE_CHECK);
+	barrierWait(&h->bar, sense);
+	traceMark(h->trace, rank, PHASE_BARRIER);
+	if (rank == 0)
+	{
+		char path[4096];
+		GridInfo info = h->ckInfo;
+		info.iterations = iterations;
+		info.tol = global;
+		checkpointPath(path, sizeof(path), h->ckBase, h->ckSlot);
+		if (writerCommit(&h->ckWriter, path, &info, GRID_FORMAT_CHECKPOINT) != 0)
+			fprintf(stderr, "heat2d: cannot start writing checkpoint '%s'\n", path);
+		h->ckSlot = 1 - h->ckSlot;
+	}
+	*next = iterations + h->ckEvery;
+}
+
+/*
+ *	First power of two above the iterations already done (for printing)
+ */
+static int firstPrint(int iterations)
+{
+	int print = 1;
+	while (print <= iterations)
+		print *= 2;
+	return print;
+}
+
+/* Modified version of heat2dSolve that utilize multiple threads
+ *	Parameters: the context, epsilon value, the thread's local sense for
+ *	h->bar, and the starting and ending coordinate of the block (rows) in
+ *	the shared grid u.
+ *	Jacobi iterations run depth sweeps per temporal block (see
+ *	heat2dSweepBlocked). Before each block the thread copies the depth rows
+ *	above and below its block into private halo buffers and recomputes them
+ *	along with its own rows, so the block needs no exchange until its end
+ *	and the result is the same as depth separate sweeps.
+ *	With METHOD_SOR the rows are relaxed red-black in place instead, reading
+ *	the neighbouring blocks directly, so no halo buffers are used.
+ *	Iterations that are not checked for convergence (see h->policy) use
+ *	the update-only kernels and end with a plain barrier.
+ *	Return: number of iterations that it took
+ */
+static int heat2dSolvePara(Heat2d *h, double eps, int printBool, double *tol, int rank,
+		int *sense, int copyStart, int copyEnd, int method, double omega, int depth,
+		int height)
+{
+
+	int iterations = h->startIterations;
+	int iterations_print = firstPrint(h->startIterations);
+	int checkpoint_next = h->startIterations + h->ckEvery;
+	int N = h->N;
+	int i;
+	double diff = 2.0 * eps;
+
+	//Rows of u updated by this thread
+	int first = (copyStart == 0) ? 1 : copyStart;
+	int last = (copyEnd >= h->M) ? h->M - 2 : copyEnd - 1;
+
+	//Rows read by a temporal block: the thread's rows plus depth halo rows on
+	//each side, clipped to the plate
+	int lo = (copyStart - depth < 0) ? 0 : copyStart - depth;
+	int hi = (copyEnd + depth > h->M) ? h->M : copyEnd + depth;
+	Grid haloTop;	/* private copies of rows lo..copyStart-1 */
+	Grid haloBot;	/* private copies of rows copyEnd..hi-1 */
+	double **rows = NULL;	/* rows[i - lo] is row i, in u or in a halo */
+	double **scratch = NULL;	/* saved rows of each sweep */
+
+	haloTop.data = NULL;
+	haloBot.data = NULL;
+	if (method == METHOD_JACOBI)
+	{
+		if (copyStart > lo)
+			gridAlloc(&haloTop, copyStart - lo, N);
+		if (hi > copyEnd)
+			gridAlloc(&haloBot, hi - copyEnd, N);
+		rows = malloc((hi - lo) * sizeof(double *));
+		for (i = lo; i < hi; i++)
+		{
+			if (i < copyStart)
+				rows[i - lo] = GRID_ROW(&haloTop, i - lo);
+			else if (i < copyEnd)
+				rows[i - lo] = GRID_ROW(&h->u, i);
+			else
+				rows[i - lo] = GRID_ROW(&haloBot, i - copyEnd);
+		}
+		scratch = malloc(2 * depth * sizeof(double *));
+		for (i = 0; i < 2 * depth; i++)
+			scratch[i] = rowAlloc(N);
+		if (height <= 0)
+			height = heat2dTileHeight(N, depth);
+	}
+
+	if (printBool && rank == 0) 
+		printf( "\n Iteration  Change\n" );
+
+	double global = 2.0 * eps;	/* max change over all threads */
+	Convergence conv;
+
+	convergeInit(&conv, &h->policy);
+	convergeResume(&conv, iterations);
+	traceStart(h->trace, rank);
+	while ( eps <= global && !convergeStopped(&conv, iterations) )
+	{
+		int step = (method == METHOD_JACOBI) ? depth : 1;
+		int check = convergeDue(&conv, iterations, step);
+		int track = check && conv.policy.norm == CHECK_DELTA;
+
+		traceIteration(h->trace, rank);
+		/*
+		 * 	Copy phrase, no one write anything
+		 */
+		if (method == METHOD_JACOBI)
+		{
+			//Copy top's buffer
+			for (i = lo; i < copyStart; i++)
+				memcpy(rows[i - lo], GRID_ROW(&h->u, i), N*sizeof(double));
+			//Copy bottom's buffer
+			for (i = copyEnd; i < hi; i++)
+				memcpy(rows[i - lo], GRID_ROW(&h->u, i), N*sizeof(double));
+			traceMark(h->trace, rank, PHASE_HALO);
+		}
+
+		//Make sure that everyone is ready (copied halo buffers)
+		barrierWait(&h->bar, sense);
+		traceMark(h->trace, rank, PHASE_BARRIER);
+		/*
+		   Determine the new estimate of the solution at the interior points.
+		   The new solution W is the average of north, south, east and west 
+		   neighbors.  
+        */
+		diff = 0.0;
+		if (method == METHOD_SOR)
+		{
+			//Red points first, everyone has to finish them before black starts
+			if (first <= last)
+				diff = heat2dSweepRB(&h->u, first, last, RED, omega, track);
+			traceMark(h->trace, rank, PHASE_COMPUTE);
+			barrierWait(&h->bar, sense);
+			traceMark(h->trace, rank, PHASE_BARRIER);
+			if (first <= last)
+			{
+				double delta = heat2dSweepRB(&h->u, first, last, BLACK, omega, track);
+				if (delta > diff)
+					diff = delta;
+			}
+			iterations++;
+		}
+		else
+		{
+			if (first <= last)
+				diff = heat2dSweepBlocked(rows, N, lo, hi, lo == 0, hi == h->M,
+						depth, height, scratch, track);
+			iterations += depth;
+		}
+		traceMark(h->trace, rank, PHASE_COMPUTE);
+		//Everyone is done with this iteration; combine the max changes
+		if (!check)
+		{
+			barrierWait(&h->bar, sense);
+			traceMark(h->trace, rank, PHASE_BARRIER);
+			continue;
+		}
+		if (rank == 0)
+			checkpointDecide(h, iterations, checkpoint_next);
+		global = checkPara(h, &h->u, rank, conv.policy.norm, sense, first, last, diff);
+		convergeUpdate(&conv, iterations, global, eps);
+		checkpointPara(h, &h->u, rank, sense, iterations, global, &checkpoint_next);
+
+		if ( printBool && iterations >= iterations_print )
+		{
+			if (rank == 0)
+				printf ( "  %8d  %f\n", iterations, global );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	} 
+	traceStop(h->trace, rank);
+	if (rank == 0)
+		h->globalDiff = global;
+	/* memory cleanup */
+	if (scratch != NULL)
+	{
+		for (i = 0; i < 2 * depth; i++)
+			free(scratch[i]);
+	}
+	free(scratch);
+	free(rows);
+	gridFree(&haloTop);
+	gridFree(&haloBot);
+	*tol = global;
+	return iterations;
+}
+
+/* heat2dSolvePara for ping-pong Jacobi (--jacobi=pingpong): every sweep
+ *	reads the rows of one of h->u and h->v, the neighbouring threads' rows
+ *	included, and writes this thread's rows of the other. Nothing is copied
+ *	and the only barrier of an iteration is the one that ends it: nobody
+ *	may overwrite a plate before everyone has read it.
+ *	sense - the thread's local sense for bar (updated)
+ *	Return: number of iterations that it took
+ */
+static int heat2dSolveParaPP(Heat2d *h, double eps, int printBool, double *tol, int rank,
+		int *sense, int copyStart, int copyEnd)
+{
+	int iterations = h->startIterations;
+	int iterations_print = firstPrint(h->startIterations);
+	int checkpoint_next = h->startIterations + h->ckEvery;
+	int N = h->N;
+	int first = (copyStart == 0) ? 1 : copyStart;
+	int last = (copyEnd >= h->M) ? h->M - 2 : copyEnd - 1;
+	Grid *src = &h->u, *dst = &h->v, *tmp;
+	double diff;
+	double global = 2.0 * eps;
+	Convergence conv;
+	int i;
+
+	//This thread's rows of v, boundary included, so they are first touched
+	//here; the barrier of the first sweep orders them before any read
+	for (i = copyStart; i < copyEnd; i++)
+		memcpy(GRID_ROW(&h->v, i), GRID_ROW(&h->u, i), N*sizeof(double));
+
+	if (printBool && rank == 0)
+		printf( "\n Iteration  Change\n" );
+
+	convergeInit(&conv, &h->policy);
+	convergeResume(&conv, iterations);
+	traceStart(h->trace, rank);
+	while ( eps <= global && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+		int track = check && conv.policy.norm == CHECK_DELTA;
+
+		traceIteration(h->trace, rank);
+		diff = 0.0;
+		if (first <= last)
+			diff = heat2dSweepPingPong(dst, src, h->geoSweep, first, last, track);
+		tmp = src; src = dst; dst = tmp;
+		iterations++;
+		traceMark(h->trace, rank, PHASE_COMPUTE);
+		if (!check)
+		{
+			barrierWait(&h->bar, sense);
+			traceMark(h->trace, rank, PHASE_BARRIER);
+			continue;
+		}
+		if (rank == 0)
+			checkpointDecide(h, iterations, checkpoint_next);
+		global = checkPara(h, src, rank, conv.policy.norm, sense, first, last, diff);
+		convergeUpdate(&conv, iterations, global, eps);
+		checkpointPara(h, src, rank, sense, iterations, global, &checkpoint_next);
+
+		if ( printBool && iterations >= iterations_print )
+		{
+			if (rank == 0)
+				printf ( "  %8d  %f\n", iterations, global );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	traceStop(h->trace, rank);
+	//Nobody reads the plates any more: put this thread's newest rows in u
+	if (src != &h->u)
+		for (i = first; i <= last; i++)
+			memcpy(GRID_ROW(&h->u, i), GRID_ROW(src, i), N*sizeof(double));
+	if (rank == 0)
+		h->globalDiff = global;
+	*tol = global;
+	return iterations;
+}
+
+/* heat2dSolvePara for --precision=float|mixed: Jacobi sweeps of the rows
+ *	copyStart..copyEnd-1 of the single precision plate uf, with one private
+ *	halo row above and below that is refreshed before every sweep.
+ *	sense - the thread's local sense for bar (updated)
+ *	Return: number of iterations that it took
+ */
+static int heat2dSolveParaF(Heat2d *h, double eps, int printBool, double *tol, int rank,
+		int *sense, int copyStart, int copyEnd)
+{
+	int iterations = h->startIterations;
+	int iterations_print = firstPrint(h->startIterations);
+	int N = h->N;
+	int first = (copyStart == 0) ? 1 : copyStart;
+	int last = (copyEnd >= h->M) ? h->M - 2 : copyEnd - 1;
+	float* haloTop = rowAllocF(N);	/* row first-1 as of the previous sweep */
+	float* haloBot = rowAllocF(N);	/* row last+1 as of the previous sweep */
+	float* rowPrev = rowAllocF(N);
+	float* rowCurr = rowAllocF(N);
+	double diff;
+	double global = 2.0 * eps;
+	Convergence conv;
+
+	if (printBool && rank == 0)
+		printf( "\n Iteration  Change\n" );
+
+	convergeInit(&conv, &h->policy);
+	convergeResume(&conv, iterations);
+	traceStart(h->trace, rank);
+	while ( eps <= global && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1);
+
+		traceIteration(h->trace, rank);
+		if (first <= last)
+		{
+			memcpy(haloTop, GRIDF_ROW(&h->uf, first - 1), N*sizeof(float));
+			memcpy(haloBot, GRIDF_ROW(&h->uf, last + 1), N*sizeof(float));
+		}
+		traceMark(h->trace, rank, PHASE_HALO);
+		barrierWait(&h->bar, sense);
+		traceMark(h->trace, rank, PHASE_BARRIER);
+		diff = 0.0;
+		if (first <= last)
+			diff = heat2dSweepF(&h->uf, first, last, haloTop, haloBot, rowPrev, rowCurr, check);
+		iterations++;
+		traceMark(h->trace, rank, PHASE_COMPUTE);
+		if (!check)
+		{
+			barrierWait(&h->bar, sense);
+			traceMark(h->trace, rank, PHASE_BARRIER);
+			continue;
+		}
+		global = barrierReduceMax(&h->bar, sense, diff);
+		traceMark(h->trace, rank, PHASE_BARRIER);
+		convergeUpdate(&conv, iterations, global, eps);
+		if ( printBool && iterations >= iterations_print )
+		{
+			if (rank == 0)
+				printf ( "  %8d  %f\n", iterations, global );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	traceStop(h->trace, rank);
+	if (rank == 0)
+		h->globalDiff = global;
+	free(haloTop);
+	free(haloBot);
+	free(rowPrev);
+	free(rowCurr);
+	*tol = global;
+	return iterations;
+}
+
+/*
+ *	--precision=float|mixed: every thread rounds its rows into uf, sweeps
+ *	them in single precision and widens them back into u. In mixed mode the
+ *	threads then carry on with double precision sweeps from there.
+ *	Return: number of iterations, float and double together
+ */
+static int solveMixed(Heat2d *h, Param *p)
+{
+	int print = h->cfg.print;
+	int iters;
+
+	gridToFloat(&h->uf, &h->u, p->copyStart, p->copyEnd - 1);
+	barrierWait(&h->bar, &p->sense);
+	iters = heat2dSolveParaF(h, h->floatEps, print, &p->tol, p->rank, &p->sense,
+			p->copyStart, p->copyEnd);
+	gridToDouble(&h->u, &h->uf, p->copyStart, p->copyEnd - 1);
+	if (h->cfg.opts.precision == PRECISION_FLOAT)
+		return iters;
+
+	//The double sweeps continue the iteration count
+	if (p->rank == 0)
+	{
+		h->startIterations = iters;
+		if (print)
+			printf ( "\n  %d float sweeps, finishing in double precision\n", iters );
+	}
+	barrierWait(&h->bar, &p->sense);
+	return heat2dSolvePara(h, h->cfg.eps, print, &p->tol, p->rank, &p->sense,
+			p->copyStart, p->copyEnd, METHOD_JACOBI, 0.0, 1, 0);
+}
+
+/* Version of heat2dSolvePara that works on the 2D tiles instead of a block
+ *	of rows. Every phase takes its tiles from a phase queue, so threads that
+ *	finish early steal tiles from the others:
+ *		Jacobi: snapshot tile edges | barrier | sweep tiles | barrier + max
+ *		SOR:    red tiles           | barrier | black tiles | barrier + max
+ *	(the max only on iterations that are checked, see heat2dSolvePara).
+ *	Rank 0 refills a phase queue while the other phase is running.
+ *	With --sleep, tiles whose change falls below sleep * eps are skipped
+ *	until their edges move (see heat2d_tiles.h). Their change is then not
+ *	measured, so a change below eps only ends the solve once a sweep with
+ *	every tile awake confirms it; a residual norm covers them anyway.
+ *	Return: number of iterations that it took
+ */
+static int heat2dSolveTiles(Heat2d *h, double eps, int printBool, double *tol, int rank,
+		int *sense, int method, double omega)
+{
+	int iterations = h->startIterations;
+	int iterations_print = firstPrint(h->startIterations);
+	int checkpoint_next = h->startIterations + h->ckEvery;
+	int k;
+	double diff;
+	double *rowPrev = rowAlloc(h->tiles.width + 2);
+	double *rowCurr = rowAlloc(h->tiles.width + 2);
+	double sleep = h->cfg.opts.sleep * eps;	/* change below which a tile sleeps */
+	int wake = 1;		/* wake every tile: the plate may have changed since the last job */
+	int verify = 0;		/* this sweep confirms a change below eps */
+	long slept;			/* tiles found asleep by this thread in this sweep */
+	Param *p = &h->param[rank];
+
+	if (printBool && rank == 0)
+		printf( "\n Iteration  Change\n" );
+
+	double global = 2.0 * eps;	/* max change over all threads */
+	Convergence conv;
+
+	//Rows whose residual this thread computes for a residual check
+	int first = 1 + (int) ((long) (h->M - 2) * rank / h->threads);
+	int last = (int) ((long) (h->M - 2) * (rank + 1) / h->threads);
+
+	convergeInit(&conv, &h->policy);
+	convergeResume(&conv, iterations);
+	p->swept = p->slept = 0;
+	traceStart(h->trace, rank);
+	while ( (eps <= global || verify) && !convergeStopped(&conv, iterations) )
+	{
+		int check = convergeDue(&conv, iterations, 1) || verify;
+		int track = (check && conv.policy.norm == CHECK_DELTA) || sleep > 0;
+
+		traceIteration(h->trace, rank);
+		diff = 0.0;
+		slept = 0;
+		//First phase: snapshot the edges around every tile / red points
+		while ((k = taskNext(&h->phaseQueue[0], rank)) >= 0)
+		{
+			if (method == METHOD_SOR)
+			{
+				double delta = tileSweepRB(&h->tiles.tiles[k], &h->u, RED, omega, track);
+				if (delta > diff)
+					diff = delta;
+			}
+			else
+			{
+				Tile *t = &h->tiles.tiles[k];
+				if (t->asleep && !wake && tileDrift(t, &h->u) <= sleep)
+					continue;
+				t->asleep = 0;
+				tileSnapshot(t, &h->u);
+			}
+		}
+		traceMark(h->trace, rank, (method == METHOD_SOR) ? PHASE_COMPUTE : PHASE_HALO);
+		barrierWait(&h->bar, sense);
+		traceMark(h->trace, rank, PHASE_BARRIER);
+		if (rank == 0)
+			taskQueueReset(&h->phaseQueue[0]);
+
+		//Second phase: sweep every tile / black points
+		while ((k = taskNext(&h->phaseQueue[1], rank)) >= 0)
+		{
+			Tile *t = &h->tiles.tiles[k];
+			double delta;
+			p->swept++;
+			if (method == METHOD_SOR)
+				delta = tileSweepRB(t, &h->u, BLACK, omega, track);
+			else if (t->asleep)
+			{
+				slept++;
+				continue;
+			}
+			else
+			{
+				delta = tileSweep(t, &h->u, rowPrev, rowCurr, track);
+				t->asleep = (delta < sleep);
+			}
+			if (delta > diff)
+				diff = delta;
+		}
+		p->slept += slept;
+		wake = verify = 0;
+		iterations++;
+		traceMark(h->trace, rank, PHASE_COMPUTE);
+		if (check)
+		{
+			if (rank == 0)
+				checkpointDecide(h, iterations, checkpoint_next);
+			global = checkPara(h, &h->u, rank, conv.policy.norm, sense, first, last, diff);
+			convergeUpdate(&conv, iterations, global, eps);
+			checkpointPara(h, &h->u, rank, sense, iterations, global, &checkpoint_next);
+			if (global < eps && sleep > 0 && conv.policy.norm == CHECK_DELTA)
+				wake = verify = (barrierReduceMax(&h->bar, sense, (double) slept) > 0);
+		}
+		else
+		{
+			barrierWait(&h->bar, sense);
+			traceMark(h->trace, rank, PHASE_BARRIER);
+		}
+		if (rank == 0)
+			taskQueueReset(&h->phaseQueue[1]);
+
+		if ( printBool && check && iterations >= iterations_print )
+		{
+			if (rank == 0)
+				printf ( "  %8d  %f\n", iterations, global );
+			while (iterations_print <= iterations)
+				iterations_print *= 2;
+		}
+	}
+	traceStop(h->trace, rank);
+	if (rank == 0)
+		h->globalDiff = global;
+	free(rowCurr);
+	free(rowPrev);
+	*tol = global;
+	return iterations;
+}
+
+/*
+ *	Pool job for the row strips: Jacobi (ping-pong or in place), SOR or
+ *	reduced precision
+ */
+static void solve(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	Param *p = &h->param[rank];
+	Options *opts = &h->cfg.opts;
+
+	if (opts->precision != PRECISION_DOUBLE)
+	{
+		p->iter = solveMixed(h, p);
+		return;
+	}
+	if (h->pingPong)
+	{
+		p->iter = heat2dSolveParaPP(h, h->cfg.eps, h->cfg.print, &p->tol, rank, &p->sense,
+				p->copyStart, p->copyEnd);
+		return;
+	}
+	p->iter = heat2dSolvePara(h, h->cfg.eps, h->cfg.print, &p->tol, rank, &p->sense,
+			p->copyStart, p->copyEnd, opts->method, optionsOmega(opts, h->M, h->N),
+			opts->tbDepth, opts->tbHeight);
+}
+
+/*
+ *	Pool job for the tile decomposition
+ */
+static void solveTiles(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	Param *p = &h->param[rank];
+	Options *opts = &h->cfg.opts;
+
+	p->iter = heat2dSolveTiles(h, h->cfg.eps, h->cfg.print, &p->tol, rank, &p->sense,
+			opts->method, optionsOmega(opts, h->M, h->N));
+}
+
+/*
+ *	Pool job for --method=mg: every worker takes its share of rows on each level
+ */
+static void solveMG(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	Param *p = &h->param[rank];
+
+	p->iter = h->startIterations + mgSolve(&h->mg, rank, h->cfg.eps, h->cfg.print, &p->tol);
+	if (rank == 0)
+		h->globalDiff = p->tol;
+}
+
+/*
+ *	Pool job for --method=cg: every worker takes its share of rows of each
+ *	vector operation
+ */
+static void solveCG(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	Param *p = &h->param[rank];
+
+	p->iter = h->startIterations + pcgSolve(&h->cg, rank, h->cfg.eps, h->cfg.print, &p->tol);
+	if (rank == 0)
+		h->globalDiff = p->tol;
+}
+
+/*
+ *	Create a context and set up its plate: boundary, initial guess (or the
+ *	checkpoint it resumes from) and whatever the configured solver needs.
+ *	Return: the context, NULL on failure
+ */
+Heat2d *heat2dCreate(const Heat2dConfig *cfg)
+{
+	const Options *opts = &cfg->opts;
+	Heat2d *h = calloc(1, sizeof(Heat2d));
+	int thread;
+
+	if (h == NULL)
+		return NULL;
+	h->cfg = *cfg;
+	h->M = cfg->M;
+	h->N = cfg->N;
+	h->threads = cfg->threads;
+	h->policy = opts->check;
+	h->change = 2.0 * cfg->eps;
+	writerInit(&h->writer);
+	writerInit(&h->ckWriter);
+
+	if (h->M < 0 || h->N < 0 || h->threads < 0 || cfg->eps < 0)
+	{
+		fprintf(stderr, "heat2d: invalid plate configuration\n");
+		goto fail;
+	}
+	if (h->threads == 0 && (opts->checkpoint != NULL || opts->resume != NULL ||
+				opts->affinity != NULL || opts->placement || opts->trace ||
+				opts->tileHeight > 0 || opts->sleep > 0))
+	{
+		fprintf(stderr, "heat2d: --checkpoint, --resume, --affinity, --placement, --trace,\n"
+				"--tile and --sleep need threads\n");
+		goto fail;
+	}
+	if (heat2dKernelInit(opts->kernel) != 0)
+	{
+		fprintf(stderr, "heat2d: kernel '%s' is not available on this CPU\n", opts->kernel);
+		goto fail;
+	}
+	if (gridAlloc(&h->u, h->M, h->N) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot allocate a %d x %d grid\n", h->M, h->N);
+		goto fail;
+	}
+	h->room = (size_t) h->M * h->u.stride * sizeof(double);
+
+	if (h->threads > 0)
+	{
+		//Start the workers, or take the caller's; they stay parked in the
+		//pool between jobs
+		h->pool = (cfg->pool != NULL) ? cfg->pool : poolCreate(h->threads);
+		if (h->pool == NULL)
+		{
+			fprintf(stderr, "heat2d: cannot start %d threads\n", h->threads);
+			goto fail;
+		}
+		if (h->pool->size != h->threads)
+		{
+			fprintf(stderr, "heat2d: the pool has %d threads, not %d\n", h->pool->size,
+					h->threads);
+			goto fail;
+		}
+		//The owner of a shared pool pins it
+		if (opts->affinity != NULL && cfg->pool == NULL)
+		{
+			int *cpus = malloc(h->threads * sizeof(int));
+			if (cpus == NULL || affinityCpus(opts->affinity, h->threads, cpus) != 0 ||
+					poolPin(h->pool, cpus) != 0)
+			{
+				fprintf(stderr, "heat2d: cannot pin the threads with --affinity=%s\n",
+						opts->affinity);
+				free(cpus);
+				goto fail;
+			}
+			if (cfg->print)
+			{
+				printf("  Affinity: %s, CPUs", opts->affinity);
+				for (thread = 0; thread < h->threads; thread++)
+					printf(" %d", cpus[thread]);
+				printf("\n");
+			}
+			free(cpus);
+		}
+		h->param = calloc(h->threads, sizeof(Param));
+		h->rowNorm = malloc(h->M * sizeof(double));
+		if (h->param == NULL || h->rowNorm == NULL)
+		{
+			fprintf(stderr, "heat2d: out of memory\n");
+			goto fail;
+		}
+		barrierInit(&h->bar, h->threads);
+		splitStrips(h);
+
+		if (opts->tileHeight > 0)
+		{
+			//2D tiles handed out to the workers through the phase queues
+			if (tilesInit(&h->tiles, &h->u, opts->tileHeight, opts->tileWidth) != 0)
+			{
+				fprintf(stderr, "heat2d: cannot allocate the tiles\n");
+				goto fail;
+			}
+			h->useTiles = 1;
+			if (taskQueueInit(&h->phaseQueue[0], h->threads, h->tiles.count) != 0 ||
+					taskQueueInit(&h->phaseQueue[1], h->threads, h->tiles.count) != 0)
+			{
+				fprintf(stderr, "heat2d: cannot allocate the tiles\n");
+				goto fail;
+			}
+			if (cfg->print)
+				printf("  %d x %d tiles of %d x %d points\n", h->tiles.rows, h->tiles.cols,
+						h->tiles.height, h->tiles.width);
+		}
+
+		/* Set the boundary values, which don't change.  */
+		//Every worker fills the rows or tiles it will sweep, so their pages are
+		//first touched, and placed, on its own NUMA node
+		poolRun(h->pool, touchPlate, h);
+	}
+	else
+		initialize_plate(&h->u, cfg->Tl, cfg->Tr, cfg->Tt, cfg->Tb);
+
+	if (heat2dInitialGuess(&h->u, opts->init, cfg->eps) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot read the initial guess '%s'\n", opts->init);
+		goto fail;
+	}
+
+	h->ckInfo.Tl = cfg->Tl;
+	h->ckInfo.Tr = cfg->Tr;
+	h->ckInfo.Tt = cfg->Tt;
+	h->ckInfo.Tb = cfg->Tb;
+	h->ckBase = opts->checkpoint;
+	h->ckEvery = opts->checkpointEvery;
+	h->ckSlot = 0;
+	if (opts->resume != NULL)
+	{
+		GridInfo saved;
+		int slot = checkpointLoad(opts->resume, &h->u, &saved);
+		if (slot < 0)
+		{
+			fprintf(stderr, "heat2d: no %d x %d checkpoint in '%s'\n",
+					h->M, h->N, opts->resume);
+			goto fail;
+		}
+		if (saved.Tl != cfg->Tl || saved.Tr != cfg->Tr || saved.Tt != cfg->Tt ||
+				saved.Tb != cfg->Tb)
+		{
+			fprintf(stderr, "heat2d: '%s' has other boundary temperatures\n", opts->resume);
+			goto fail;
+		}
+		//Overwrite the older slot first
+		h->ckSlot = (slot == 0) ? 1 : 0;
+		h->iterations = saved.iterations;
+		h->change = saved.tol;
+		if (cfg->print)
+			printf("  Resuming after iteration %d (change %f)\n", saved.iterations, saved.tol);
+	}
+
+	if (opts->geometry != NULL)
+	{
+		if (geometryRead(&h->geo, opts->geometry, h->M, h->N) != 0)
+			goto fail;
+		geometryApply(&h->geo, &h->u);
+		h->geoSweep = &h->geo;
+		if (cfg->print)
+			printf("  Geometry %s: %ld fixed, %ld source and %ld cutout points\n",
+					opts->geometry, h->geo.fixed, h->geo.sources, h->geo.cutout);
+	}
+
+	if (opts->method == METHOD_MG)
+	{
+		if (mgInit(&h->mg, &h->u, (h->threads > 0) ? h->threads : 1, opts->mgCycle) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the multigrid levels\n");
+			goto fail;
+		}
+		h->useMG = 1;
+		if (cfg->print)
+			printf("  %d multigrid levels\n", h->mg.levels);
+	}
+	if (opts->method == METHOD_CG)
+	{
+		if (pcgInit(&h->cg, &h->u, (h->threads > 0) ? h->threads : 1, opts->precond) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the conjugate gradient vectors\n");
+			goto fail;
+		}
+		h->useCG = 1;
+	}
+
+	h->pingPong = optionsPingPong(opts, h->M, h->N, h->threads);
+	if (h->pingPong && gridAlloc(&h->v, h->M, h->N) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot allocate the second plate of --jacobi=pingpong\n");
+		goto fail;
+	}
+
+	if (opts->precision != PRECISION_DOUBLE)
+	{
+		//The serial solver keeps its own copy; the threads fill this one,
+		//each with its own rows
+		if (h->threads > 0 && gridAllocF(&h->uf, h->M, h->N) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the single precision grid\n");
+			goto fail;
+		}
+		h->floatEps = heat2dFloatFloor(&h->u);
+		h->floatEps = (cfg->eps > h->floatEps) ? cfg->eps : h->floatEps;
+	}
+
+	if (opts->trace)
+	{
+		if (traceInit(&h->traceData, h->threads, opts->traceFile != NULL) != 0)
+		{
+			traceFree(&h->traceData);
+			fprintf(stderr, "heat2d: cannot allocate the trace\n");
+			goto fail;
+		}
+		h->trace = &h->traceData;
+	}
+
+	if (opts->placement && cfg->print)
+		printPlacement(h);
+	return h;
+
+fail:
+	heat2dDestroy(h);
+	return NULL;
+}
+
+/*
+ *	A new start from the plate now in h and the boundary temperatures of
+ *	its configuration: no iterations yet, and the float floor of that plate
+ */
+static void plateRestart(Heat2d *h)
+{
+	Heat2dConfig *cfg = &h->cfg;
+
+	h->ckInfo.Tl = cfg->Tl;
+	h->ckInfo.Tr = cfg->Tr;
+	h->ckInfo.Tt = cfg->Tt;
+	h->ckInfo.Tb = cfg->Tb;
+	h->ckSlot = 0;
+	h->iterations = 0;
+	h->change = 2.0 * cfg->eps;
+	if (cfg->opts.precision != PRECISION_DOUBLE)
+	{
+		h->floatEps = heat2dFloatFloor(&h->u);
+		h->floatEps = (cfg->eps > h->floatEps) ? cfg->eps : h->floatEps;
+	}
+}
+
+/*
+ *	Rows i0..i1-1 and columns j0..j1-1 of the plate from the unit solutions
+ *	and the boundary temperatures of the configuration. Every edge point is
+ *	1 in one unit solution and 0 in the others, so it is exactly its
+ *	temperature.
+ */
+static void combineBlock(Heat2d *h, int i0, int i1, int j0, int j1)
+{
+	const Heat2dConfig *cfg = &h->cfg;
+	int i, j;
+
+	for (i = i0; i < i1; i++)
+	{
+		double *row = GRID_ROW(&h->u, i);
+		const double *l = GRID_ROW(&h->basis[0], i);
+		const double *r = GRID_ROW(&h->basis[1], i);
+		const double *t = GRID_ROW(&h->basis[2], i);
+		const double *b = GRID_ROW(&h->basis[3], i);
+		for (j = j0; j < j1; j++)
+			row[j] = cfg->Tl * l[j] + cfg->Tr * r[j] + cfg->Tt * t[j] + cfg->Tb * b[j];
+	}
+}
+
+/*
+ *	Start a new plate of the same size in h: other boundary temperatures and
+ *	eps, a fresh initial guess and no iterations. The grid, the pool and the
+ *	multigrid levels are kept, which is what makes a run of same-size plates
+ *	cheap. --resume only applies to the plate heat2dCreate() set up.
+ *	Return: 0, -1 if the initial guess could not be read
+ */
+int heat2dReset(Heat2d *h, double Tl, double Tr, double Tt, double Tb, double eps)
+{
+	Heat2dConfig *cfg = &h->cfg;
+
+	cfg->Tl = Tl;
+	cfg->Tr = Tr;
+	cfg->Tt = Tt;
+	cfg->Tb = Tb;
+	cfg->eps = eps;
+	if (h->pool != NULL)
+		poolRun(h->pool, touchPlate, h);
+	else
+		initialize_plate(&h->u, Tl, Tr, Tt, Tb);
+	if (heat2dInitialGuess(&h->u, cfg->opts.init, eps) != 0)
+	{
+		fprintf(stderr, "heat2d: cannot read the initial guess '%s'\n", cfg->opts.init);
+		return -1;
+	}
+	if (h->geoSweep != NULL)
+		geometryApply(&h->geo, &h->u);
+	plateRestart(h);
+	return 0;
+}
+
+/*
+ *	Grid g as an M x N plate in its buffer of room bytes, or in a new one of
+ *	that size if it has none
+ *	Return: 0, -1 if the buffer could not be allocated
+ */
+static int plateGrid(Grid *g, int M, int N, size_t room)
+{
+	void *data;
+
+	g->M = M;
+	g->N = N;
+	g->stride = gridStride(N);
+	if (g->data != NULL)
+		return 0;
+	if (posix_memalign(&data, GRID_ALIGN, room) != 0)
+		return -1;
+	g->data = (double *) data;
+	return 0;
+}
+
+/*
+ *	Start a new plate of size M x N in h, as heat2dReset() does for the same
+ *	size. The pool is kept, and so are the buffers of the plate while the
+ *	new one fits in them; they only grow, to the next power of two bytes,
+ *	so that plates of nearby sizes share them. The tiles, multigrid levels,
+ *	conjugate gradient vectors and geometry are set up again for the new
+ *	size.
+ *	Return: 0, -1 if the new plate cannot be set up; h can then only be
+ *	destroyed
+ */
+int heat2dResize(Heat2d *h, int M, int N, double Tl, double Tr, double Tt, double Tb,
+		double eps)
+{
+	Heat2dConfig *cfg = &h->cfg;
+	const Options *opts = &cfg->opts;
+	size_t bytes = (size_t) M * gridStride(N) * sizeof(double);
+	int k;
+
+	if (M < 0 || N < 0 || eps < 0)
+	{
+		fprintf(stderr, "heat2d: invalid plate configuration\n");
+		return -1;
+	}
+	heat2dFlush(h);
+	h->M = cfg->M = M;
+	h->N = cfg->N = N;
+	if (bytes > h->room)
+	{
+		for (h->room = 4096; h->room < bytes; h->room *= 2)
+			;
+		gridFree(&h->u);
+		gridFree(&h->v);
+	}
+	h->pingPong = optionsPingPong(opts, M, N, h->threads);
+	if (plateGrid(&h->u, M, N, h->room) != 0 ||
+			(h->pingPong && plateGrid(&h->v, M, N, h->room) != 0))
+	{
+		fprintf(stderr, "heat2d: cannot allocate a %d x %d grid\n", M, N);
+		return -1;
+	}
+	for (k = 0; k < 4; k++)
+		gridFree(&h->basis[k]);
+	h->hasBasis = 0;
+
+	if (h->threads > 0)
+	{
+		double *rowNorm = realloc(h->rowNorm, (M > 0 ? M : 1) * sizeof(double));
+		if (rowNorm == NULL)
+		{
+			fprintf(stderr, "heat2d: out of memory\n");
+			return -1;
+		}
+		h->rowNorm = rowNorm;
+		//splitStrips() starts the local senses again, and so the barrier
+		barrierInit(&h->bar, h->threads);
+		splitStrips(h);
+	}
+	if (h->useTiles)
+	{
+		taskQueueFree(&h->phaseQueue[0]);
+		taskQueueFree(&h->phaseQueue[1]);
+		tilesFree(&h->tiles);
+		h->useTiles = 0;
+		if (tilesInit(&h->tiles, &h->u, opts->tileHeight, opts->tileWidth) != 0 ||
+				taskQueueInit(&h->phaseQueue[0], h->threads, h->tiles.count) != 0 ||
+				taskQueueInit(&h->phaseQueue[1], h->threads, h->tiles.count) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the tiles\n");
+			return -1;
+		}
+		h->useTiles = 1;
+	}
+	if (h->geoSweep != NULL)
+	{
+		geometryFree(&h->geo);
+		if (geometryRead(&h->geo, opts->geometry, M, N) != 0)
+			return -1;
+	}
+	if (h->useMG)
+	{
+		mgFree(&h->mg);
+		h->useMG = 0;
+		if (mgInit(&h->mg, &h->u, (h->threads > 0) ? h->threads : 1, opts->mgCycle) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the multigrid levels\n");
+			return -1;
+		}
+		h->useMG = 1;
+	}
+	if (h->useCG)
+	{
+		pcgFree(&h->cg);
+		h->useCG = 0;
+		if (pcgInit(&h->cg, &h->u, (h->threads > 0) ? h->threads : 1, opts->precond) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the conjugate gradient vectors\n");
+			return -1;
+		}
+		h->useCG = 1;
+	}
+	if (h->uf.data != NULL)
+	{
+		gridFreeF(&h->uf);
+		if (gridAllocF(&h->uf, M, N) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the single precision grid\n");
+			return -1;
+		}
+	}
+	return heat2dReset(h, Tl, Tr, Tt, Tb, eps);
+}
+
+/*
+ *	Bytes of plate the buffers of h hold: heat2dResize() to any plate of at
+ *	most this size allocates no new plate
+ */
+size_t heat2dRoom(const Heat2d *h)
+{
+	return h->room;
+}
+
+/*
+ *	Report how many tile sweeps --sleep skipped in the last job
+ */
+static void printSleep(const Heat2d *h)
+{
+	long swept = 0, slept = 0;
+	int rank;
+
+	for (rank = 0; rank < h->threads; rank++)
+	{
+		swept += h->param[rank].swept;
+		slept += h->param[rank].slept;
+	}
+	printf("\n  %ld of %ld tile sweeps skipped (%.1f%%)\n", slept, swept,
+			(swept > 0) ? 100.0 * slept / swept : 0.0);
+}
+
+/*
+ *	Run the configured solver from the current plate until eps is reached or
+ *	limit iterations (0 = no limit) are done
+ *	Return: the iteration count so far, -1 on failure
+ */
+static int runSolver(Heat2d *h, int limit)
+{
+	const Options *opts = &h->cfg.opts;
+	double eps = h->cfg.eps;
+	int print = h->cfg.print;
+	double tol = h->change;
+	int iters;
+
+	h->policy = opts->check;
+	h->policy.limit = limit;
+	if (h->threads > 0)
+	{
+		h->startIterations = h->iterations;
+		if (h->useMG)
+			poolRun(h->pool, solveMG, h);
+		else if (h->useCG)
+			poolRun(h->pool, solveCG, h);
+		else if (h->useTiles)
+		{
+			poolRun(h->pool, solveTiles, h);
+			if (print && opts->sleep > 0)
+				printSleep(h);
+		}
+		else
+			poolRun(h->pool, solve, h);
+		h->iterations = h->param[0].iter;
+		h->change = h->globalDiff;
+		return h->iterations;
+	}
+
+	if (h->useMG)
+		iters = mgSolve(&h->mg, 0, eps, print, &tol);
+	else if (h->useCG)
+		iters = pcgSolve(&h->cg, 0, eps, print, &tol);
+	else if (opts->precision != PRECISION_DOUBLE)
+	{
+		iters = heat2dSolveMixed(&h->u, eps, opts->precision, &h->policy, print, &tol);
+		if (iters < 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the single precision grid\n");
+			return -1;
+		}
+	}
+	else if (opts->method == METHOD_SOR)
+		iters = heat2dSolveSOR(&h->u, eps, optionsOmega(opts, h->M, h->N), &h->policy,
+				print, &tol);
+	else if (opts->tbDepth > 1)
+		iters = heat2dSolveBlocked(&h->u, eps, opts->tbDepth, opts->tbHeight, &h->policy,
+				print, &tol);
+	else if (h->pingPong)
+		iters = heat2dSolvePingPong(&h->u, &h->v, h->geoSweep, eps, &h->policy, print, &tol);
+	else
+		iters = heat2dSolve(&h->u, eps, &h->policy, print, &tol);
+	h->iterations += iters;
+	h->change = tol;
+	return h->iterations;
+}
+
+/*
+ *	Iterate until the change (or the configured norm) is below eps
+ *	Return: the iteration count so far, -1 on failure
+ */
+int heat2dRun(Heat2d *h)
+{
+	return runSolver(h, 0);
+}
+
+/*
+ *	Do iterations more iterations, or fewer if eps is reached first; the
+ *	last one is always checked, so heat2dChange() is up to date. Temporal
+ *	blocking rounds the count up to whole blocks. Multigrid, conjugate
+ *	gradient and the float modes only run to convergence.
+ *	Return: the iteration count so far, -1 on failure
+ */
+int heat2dStep(Heat2d *h, int iterations)
+{
+	if (iterations < 1 || h->useMG || h->useCG || h->cfg.opts.precision != PRECISION_DOUBLE)
+	{
+		fprintf(stderr, "heat2d: heat2dStep needs a positive count, a relaxation method\n"
+				"and double precision\n");
+		return -1;
+	}
+	return runSolver(h, iterations);
+}
+
+/*
+ *	Pool job of heat2dSetBoundary(): combine the unit solutions on this
+ *	worker's part of the plate
+ */
+static void combineBasis(void *arg, int rank)
+{
+	Heat2d *h = (Heat2d *) arg;
+	int i0, i1, j0, j1;
+	int k;
+
+	for (k = 0; plateBlock(h, rank, k, &i0, &i1, &j0, &j1) == 0; k++)
+		combineBlock(h, i0, i1, j0, j1);
+}
+
+/*
+ *	Change the boundary temperatures of the plate and keep its interior.
+ *	The last solution is then the start of the next heat2dRun(), and after
+ *	a small change it is much closer to the new steady state than a fresh
+ *	initial guess (full multigrid starts over from the coarse grids,
+ *	V-cycles don't). After heat2dBasis() the plate becomes the combination
+ *	of the unit solutions instead, which is the new steady state: it takes
+ *	one pass over the plate and no iterations, and heat2dChange() is the
+ *	bound on its measure, so only a bound above eps needs a heat2dRun().
+ *	Return: 0
+ */
+int heat2dSetBoundary(Heat2d *h, double Tl, double Tr, double Tt, double Tb)
+{
+	Heat2dConfig *cfg = &h->cfg;
+
+	cfg->Tl = Tl;
+	cfg->Tr = Tr;
+	cfg->Tt = Tt;
+	cfg->Tb = Tb;
+	if (h->hasBasis && h->pool != NULL)
+		poolRun(h->pool, combineBasis, h);
+	else if (h->hasBasis)
+		combineBlock(h, 0, h->M, 0, h->N);
+	else
+	{
+		plateEdges(&h->u, Tl, Tr, Tt, Tb);
+		if (h->geoSweep != NULL)
+			geometryApply(&h->geo, &h->u);
+	}
+	plateRestart(h);
+	if (h->hasBasis)
+		h->change = fabs(Tl) * h->basisTol[0] + fabs(Tr) * h->basisTol[1] +
+			fabs(Tt) * h->basisTol[2] + fabs(Tb) * h->basisTol[3];
+	return 0;
+}
+
+/*
+ *	Solve the plate once for each edge at 1 and the others at 0, from the
+ *	mean, with the configured solver, and keep the four solutions. The
+ *	problem is linear, so from then on heat2dSetBoundary() answers any
+ *	boundary temperatures by combining them. Each is solved to eps / scale:
+ *	the measure of the combination is at most |Tl| + |Tr| + |Tt| + |Tb|
+ *	times that, so it stays below eps while that sum is at most scale.
+ *	Fixed points and sources (--geometry) would need a fifth solution and
+ *	are not supported. The plate is left at the combination for the current
+ *	boundary temperatures.
+ *	Return: the iterations of the four solves together, -1 on failure
+ */
+int heat2dBasis(Heat2d *h, double scale)
+{
+	Heat2dConfig *cfg = &h->cfg;
+	double T[4] = { cfg->Tl, cfg->Tr, cfg->Tt, cfg->Tb };
+	double eps = cfg->eps;
+	const char *init = cfg->opts.init;
+	const char *ckBase = h->ckBase;
+	int print = cfg->print;
+	int total = 0;
+	int k;
+
+	if (h->geoSweep != NULL || scale <= 0)
+	{
+		fprintf(stderr, "heat2d: heat2dBasis needs a positive scale and a plate without"
+				" --geometry\n");
+		return -1;
+	}
+	//Unit plates start from the mean, print nothing and write no checkpoints
+	h->hasBasis = 0;
+	cfg->opts.init = "mean";
+	cfg->print = 0;
+	h->ckBase = NULL;
+	for (k = 0; k < 4; k++)
+	{
+		if (h->basis[k].data == NULL && gridAlloc(&h->basis[k], h->M, h->N) != 0)
+		{
+			fprintf(stderr, "heat2d: cannot allocate the unit solutions\n");
+			break;
+		}
+		if (heat2dReset(h, k == 0, k == 1, k == 2, k == 3, eps / scale) != 0 ||
+				runSolver(h, 0) < 0)
+			break;
+		memcpy(h->basis[k].data, h->u.data, (size_t) h->M * h->u.stride * sizeof(double));
+		h->basisTol[k] = h->change;
+		total += h->iterations;
+	}
+	cfg->opts.init = init;
+	cfg->print = print;
+	cfg->eps = eps;
+	h->ckBase = ckBase;
+	if (k < 4)
+		return -1;
+	h->hasBasis = 1;
+	heat2dSetBoundary(h, T[0], T[1], T[2], T[3]);
+	return total;
+}
+
+/*
+ *	Write the plate to path in the configured format. With --async-write it
+ *	is written from a snapshot in the background (see heat2dFlush).
+ *	Return: 0, -1 if the file could not be written (or the write started)
+ */
+int heat2dWrite(Heat2d *h, const char *path)
+{
+	const Options *opts = &h->cfg.opts;
+	GridInfo info = { h->cfg.Tl, h->cfg.Tr, h->cfg.Tt, h->cfg.Tb, h->iterations, h->change };
+
+	if (opts->asyncWrite)
+		return writerStart(&h->writer, path, &h->u, &info, opts->format);
+	if (opts->format == GRID_FORMAT_TEXT && h->pool != NULL)
+		return writeTextPara(h, path);
+	return gridWriteFile(path, &h->u, &info, opts->format);
+}
+
+/*
+ *	Wait for the background writes: the solution, and the last checkpoint
+ *	(whose failure is only reported, the solve did not need it)
+ *	Return: 0, -1 if the background write of the solution failed
+ */
+int heat2dFlush(Heat2d *h)
+{
+	if (writerWait(&h->ckWriter) != 0)
+		fprintf(stderr, "heat2d: the last checkpoint could not be written\n");
+	return writerWait(&h->writer);
+}
+
+void heat2dDestroy(Heat2d *h)
+{
+	int k;
+
+	if (h == NULL)
+		return;
+	heat2dFlush(h);
+	if (h->pool != NULL && h->cfg.pool == NULL)
+		poolDestroy(h->pool);
+	if (h->useMG)
+		mgFree(&h->mg);
+	if (h->useCG)
+		pcgFree(&h->cg);
+	if (h->useTiles)
+	{
+		taskQueueFree(&h->phaseQueue[0]);
+		taskQueueFree(&h->phaseQueue[1]);
+		tilesFree(&h->tiles);
+	}
+	writerFree(&h->writer);
+	writerFree(&h->ckWriter);
+	if (h->trace != NULL)
+		traceFree(h->trace);
+	gridFreeF(&h->uf);
+	gridFree(&h->v);
+	gridFree(&h->u);
+	for (k = 0; k < 4; k++)
+		gridFree(&h->basis[k]);
+	geometryFree(&h->geo);
+	free(h->rowNorm);
+	free(h->param);
+	free(h);
+}
+
+const Grid *heat2dPlate(const Heat2d *h)
+{
+	return &h->u;
+}
+
+int heat2dIterations(const Heat2d *h)
+{
+	return h->iterations;
+}
+
+double heat2dChange(const Heat2d *h)
+{
+	return h->change;
+}
+
+/*
+ *	Print the phase times of the workers over all the runs and steps so far
+ *	(--trace)
+ *	Return: 0, -1 if the context is not traced
+ */
+int heat2dTraceReport(const Heat2d *h, FILE *fp)
+{
+	if (h->trace == NULL)
+		return -1;
+	traceReport(h->trace, fp);
+	return 0;
+}
+
+/*
+ *	Write the phases of the workers to path as Chrome trace JSON
+ *	(--trace=FILE)
+ *	Return: 0, -1 if the context keeps no events or the file could not be
+ *	written
+ */
+int heat2dTraceWrite(const Heat2d *h, const char *path)
+{
+	if (h->trace == NULL || h->trace->thread[0].events == NULL)
+		return -1;
+	return traceWrite(h->trace, path);
+}
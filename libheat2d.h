@@ -0,0 +1,86 @@
+/*
+ *	libheat2d: the plate solvers behind one reentrant interface
+ *
+ *	A Heat2d context owns everything a solve needs: the plate, its
+ *	configuration, the worker pool and the barrier, queues and scratch the
+ *	workers share. Nothing lives in globals, so one process can run any
+ *	number of contexts at once, each from its own thread. The only
+ *	process-wide setting is the stencil kernel (heat2dKernelInit); all the
+ *	kernels give bit-identical results, so it never changes an answer.
+ *
+ *	threads = 0 runs the serial solvers (heat2dSolve, heat2dSolveSOR,
+ *	heat2dSolveBlocked, ...) in the calling thread. threads >= 1 starts a
+ *	pool of that many workers and runs the threaded ones (row strips,
+ *	tiles, multigrid, conjugate gradient); pool-only options (--checkpoint, --resume,
+ *	--affinity, --placement) need threads >= 1.
+ *
+ *		Heat2dConfig cfg;
+ *		heat2dConfigDefault(&cfg);
+ *		cfg.M = cfg.N = 1000;
+ *		cfg.Tl = 100; cfg.Tr = 10; cfg.Tt = cfg.Tb = 50;
+ *		cfg.eps = 0.0005;
+ *		cfg.threads = 4;
+ *		Heat2d *h = heat2dCreate(&cfg);
+ *		heat2dRun(h);
+ *		heat2dWrite(h, "plate.out");
+ *		heat2dDestroy(h);
+ *
+ *	heat2dStep() advances by a number of iterations instead (or fewer, if
+ *	eps is reached first) and can be called repeatedly and mixed with
+ *	heat2dRun(); the iteration count carries on between calls.
+ *	heat2dReset() starts another plate of the same size in the context,
+ *	reusing its grid, pool and scratch; heat2dResize() starts one of
+ *	another size, reusing the plate buffers when it fits in them. A
+ *	caller that keeps several contexts can give them all the workers of
+ *	one pool (Heat2dConfig.pool), as long as it runs one of them at a
+ *	time. heat2dSetBoundary() changes the boundary temperatures of the
+ *	plate and keeps the last solution as the start of the next run; after
+ *	heat2dBasis() it answers a change by superposing unit solutions
+ *	instead, without iterating.
+ *
+ *	Errors are reported on stderr; calls return NULL or -1.
+ */
+#ifndef LIBHEAT2D_H
+#define LIBHEAT2D_H
+
+#include <stdio.h>
+#include "grid.h"
+#include "heat2d_options.h"
+#include "threadpool.h"
+
+typedef struct Heat2d Heat2d;
+
+typedef struct {
+	int M, N;				//plate size in points
+	double Tl, Tr, Tt, Tb;	//boundary temperatures
+	double eps;				//tolerance
+	int threads;			//0 = serial solvers in the caller's thread
+	ThreadPool *pool;		//threads workers to share, NULL = start a pool; the
+							//owner pins them and destroys them after the context
+	int print;				//progress table and reports on stdout
+	Options opts;			//method, precision, checks, ... (heat2d_options.h)
+} Heat2dConfig;
+
+void heat2dConfigDefault(Heat2dConfig *cfg);
+
+Heat2d *heat2dCreate(const Heat2dConfig *cfg);
+int heat2dReset(Heat2d *h, double Tl, double Tr, double Tt, double Tb, double eps);
+int heat2dResize(Heat2d *h, int M, int N, double Tl, double Tr, double Tt, double Tb,
+		double eps);
+size_t heat2dRoom(const Heat2d *h);
+int heat2dSetBoundary(Heat2d *h, double Tl, double Tr, double Tt, double Tb);
+int heat2dBasis(Heat2d *h, double scale);
+int heat2dRun(Heat2d *h);
+int heat2dStep(Heat2d *h, int iterations);
+int heat2dWrite(Heat2d *h, const char *path);
+int heat2dFlush(Heat2d *h);
+void heat2dDestroy(Heat2d *h);
+
+int heat2dTraceReport(const Heat2d *h, FILE *fp);
+int heat2dTraceWrite(const Heat2d *h, const char *path);
+
+const Grid *heat2dPlate(const Heat2d *h);
+int heat2dIterations(const Heat2d *h);
+double heat2dChange(const Heat2d *h);
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ *	Geometric multigrid solver for the steady state plate
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "multigrid.h"
+#include "heat2d_solver.h"
+
+//A direction with this many points or fewer is not coarsened any further
+#define MG_MIN_POINTS 5
+#define MG_MAX_LEVELS 32
+
+/* Interior rows of an M-row level handled by rank */
+static void mgRows(int M, int rank, int threads, int *first, int *last)
+{
+	*first = 1 + (int) ((long) (M - 2) * rank / threads);
+	*last = (int) ((long) (M - 2) * (rank + 1) / threads);
+}
+
+/* Points of the coarser level for a direction with n points */
+static int coarsen(int n)
+{
+	return (n > MG_MIN_POINTS) ? (n + 1) / 2 : n;
+}
+
+/*
+ * Interpolation table from a coarse direction of nc points to a fine one
+ * of nf points (both spanning the same length): fine point i lies between
+ * coarse points idx[i] and idx[i]+1, weight w[i] on the latter.
+ */
+static void upTable(int nf, int nc, int *idx, double *w)
+{
+	int i;
+	for (i = 0; i < nf; i++)
+	{
+		double x = (nf > 1) ? (double) i * (nc - 1) / (nf - 1) : 0.0;
+		int k = (int) floor(x);
+		if (k >= nc - 1)
+			k = (nc > 1) ? nc - 2 : 0;
+		idx[i] = k;
+		w[i] = (nc > 1) ? x - k : 0.0;
+	}
+}
+
+/*
+ * Nearest fine point under every coarse point
+ */
+static void downTable(int nc, int nf, int *idx)
+{
+	int i;
+	for (i = 0; i < nc; i++)
+		idx[i] = (nc > 1) ? (int) floor((double) i * (nf - 1) / (nc - 1) + 0.5) : 0;
+}
+
+/*
+ * Build the level hierarchy on top of the plate u
+ * Return: 0 on success, -1 if memory could not be allocated
+ */
+int mgInit(Multigrid *mg, Grid *u, int threads, int cycle)
+{
+	int M = u->M, N = u->N;
+	int l;
+
+	memset(mg, 0, sizeof(*mg));
+	mg->cycle = cycle;
+	mg->preSmooth = 2;
+	mg->postSmooth = 2;
+	mg->coarseSweeps = 50;
+	mg->threads = threads;
+	barrierInit(&mg->bar, threads);
+	mg->sense = calloc(threads, sizeof(int));
+	if (mg->sense == NULL)
+		return -1;
+
+	mg->level = calloc(MG_MAX_LEVELS, sizeof(MGLevel));
+	if (mg->level == NULL)
+		return -1;
+	mg->levels = 1;
+	mg->level[0].M = M;
+	mg->level[0].N = N;
+	mg->level[0].ci = 1.0;
+	mg->level[0].cj = 1.0;
+	mg->level[0].u = *u;
+
+	//Add coarser levels until both directions are small
+	while (mg->levels < MG_MAX_LEVELS)
+	{
+		MGLevel *fine = &mg->level[mg->levels - 1];
+		MGLevel *coarse = &mg->level[mg->levels];
+		int Mc = coarsen(fine->M), Nc = coarsen(fine->N);
+		double hi, hj;
+
+		if (Mc == fine->M && Nc == fine->N)
+			break;
+		coarse->M = Mc;
+		coarse->N = Nc;
+		hi = (Mc > 1) ? (double) (M - 1) / (Mc - 1) : 1.0;
+		hj = (Nc > 1) ? (double) (N - 1) / (Nc - 1) : 1.0;
+		coarse->ci = 1.0 / (hi * hi);
+		coarse->cj = 1.0 / (hj * hj);
+		mg->levels++;
+	}
+
+	for (l = 0; l < mg->levels; l++)
+	{
+		MGLevel *lv = &mg->level[l];
+		if (gridAlloc(&lv->r, lv->M, lv->N) != 0)
+			return -1;
+		if (l > 0 && (gridAlloc(&lv->u, lv->M, lv->N) != 0 ||
+					gridAlloc(&lv->f, lv->M, lv->N) != 0))
+			return -1;
+		if (l + 1 < mg->levels)
+		{
+			MGLevel *coarse = &mg->level[l + 1];
+			lv->upI = malloc(lv->M * sizeof(int));
+			lv->upA = malloc(lv->M * sizeof(double));
+			lv->upJ = malloc(lv->N * sizeof(int));
+			lv->upB = malloc(lv->N * sizeof(double));
+			coarse->downI = malloc(coarse->M * sizeof(int));
+			coarse->downJ = malloc(coarse->N * sizeof(int));
+			if (!lv->upI || !lv->upA || !lv->upJ || !lv->upB ||
+					!coarse->downI || !coarse->downJ)
+				return -1;
+			upTable(lv->M, coarse->M, lv->upI, lv->upA);
+			upTable(lv->N, coarse->N, lv->upJ, lv->upB);
+			downTable(coarse->M, lv->M, coarse->downI);
+			downTable(coarse->N, lv->N, coarse->downJ);
+		}
+	}
+	return 0;
+}
+
+void mgFree(Multigrid *mg)
+{
+	int l;
+	free(mg->sense);
+	mg->sense = NULL;
+	if (mg->level == NULL)
+		return;
+	for (l = 0; l < mg->levels; l++)
+	{
+		MGLevel *lv = &mg->level[l];
+		if (l > 0)
+		{
+			gridFree(&lv->u);
+			gridFree(&lv->f);
+		}
+		gridFree(&lv->r);
+		free(lv->upI); free(lv->upA); free(lv->upJ); free(lv->upB);
+		free(lv->downI); free(lv->downJ);
+	}
+	free(mg->level);
+	mg->level = NULL;
+}
+
+/*
+ * sweeps red-black Gauss-Seidel sweeps on level l. Level 0 uses the plate
+ * stencil; coarse levels solve ci*(2u - uN - uS) + cj*(2u - uW - uE) = f.
+ */
+static void mgSmooth(Multigrid *mg, int l, int rank, int *sense, int sweeps)
+{
+	MGLevel *lv = &mg->level[l];
+	double inv = 1.0 / (2.0 * lv->ci + 2.0 * lv->cj);
+	int first, last, s, color, i, j;
+
+	mgRows(lv->M, rank, mg->threads, &first, &last);
+	for (s = 0; s < sweeps; s++)
+	{
+		for (color = RED; color <= BLACK; color++)
+		{
+			if (l == 0)
+			{
+				if (first <= last)
+					heat2dSweepRB(&lv->u, first, last, color, 1.0, 0);
+			}
+			else
+			{
+				for (i = first; i <= last; i++)
+				{
+					double *row = GRID_ROW(&lv->u, i);
+					const double *n = GRID_ROW(&lv->u, i - 1);
+					const double *so = GRID_ROW(&lv->u, i + 1);
+					const double *f = GRID_ROW(&lv->f, i);
+					for (j = ((i + 1) % 2 == color) ? 1 : 2; j < lv->N - 1; j += 2)
+						row[j] = (f[j] + lv->ci * (n[j] + so[j]) +
+								lv->cj * (row[j-1] + row[j+1])) * inv;
+				}
+			}
+			barrierWait(&mg->bar, sense);
+		}
+	}
+}
+
+/*
+ * r = f - A u on the rows of rank
+ * Return: the largest |r| of those rows
+ */
+static double mgResidual(Multigrid *mg, int l, int rank)
+{
+	MGLevel *lv = &mg->level[l];
+	double diag = 2.0 * lv->ci + 2.0 * lv->cj;
+	double rmax = 0.0;
+	int first, last, i, j;
+
+	mgRows(lv->M, rank, mg->threads, &first, &last);
+	for (i = first; i <= last; i++)
+	{
+		const double *row = GRID_ROW(&lv->u, i);
+		const double *n = GRID_ROW(&lv->u, i - 1);
+		const double *so = GRID_ROW(&lv->u, i + 1);
+		const double *f = (l > 0) ? GRID_ROW(&lv->f, i) : NULL;
+		double *r = GRID_ROW(&lv->r, i);
+		for (j = 1; j < lv->N - 1; j++)
+		{
+			double res = lv->ci * (n[j] + so[j]) + lv->cj * (row[j-1] + row[j+1])
+				- diag * row[j];
+			if (f != NULL)
+				res += f[j];
+			r[j] = res;
+			res = fabs(res);
+			rmax = (res > rmax) ? res : rmax;
+		}
+	}
+	return rmax;
+}
+
+/* Zero row i of a level's u and f */
+static void mgClearRow(MGLevel *lv, int i)
+{
+	memset(GRID_ROW(&lv->u, i), 0, lv->N * sizeof(double));
+	memset(GRID_ROW(&lv->f, i), 0, lv->N * sizeof(double));
+}
+
+/*
+ * f(l+1) = full weighting of r(l); u(l+1) = 0, boundary included.
+ * In a direction that was not coarsened the weights are (0, 1, 0).
+ */
+static void mgRestrict(Multigrid *mg, int l, int rank)
+{
+	MGLevel *fine = &mg->level[l];
+	MGLevel *coarse = &mg->level[l + 1];
+	double wi = (coarse->M < fine->M) ? 0.25 : 0.0;	/* weight of i-1 and i+1 */
+	double wj = (coarse->N < fine->N) ? 0.25 : 0.0;
+	int first, last, I, J;
+
+	mgRows(coarse->M, rank, mg->threads, &first, &last);
+	//The boundary rows belong to the first and last thread
+	if (rank == 0)
+		mgClearRow(coarse, 0);
+	if (rank == mg->threads - 1)
+		mgClearRow(coarse, coarse->M - 1);
+	for (I = first; I <= last; I++)
+	{
+		double *f = GRID_ROW(&coarse->f, I);
+		memset(GRID_ROW(&coarse->u, I), 0, coarse->N * sizeof(double));
+		int i = coarse->downI[I];
+		const double *rn = GRID_ROW(&fine->r, i - 1);
+		const double *rc = GRID_ROW(&fine->r, i);
+		const double *rs = GRID_ROW(&fine->r, i + 1);
+		f[0] = f[coarse->N - 1] = 0.0;
+		for (J = 1; J < coarse->N - 1; J++)
+		{
+			int j = coarse->downJ[J];
+			//Weights (w, 1-2w, w) in each direction; the fine residual is
+			//only defined on interior points, treat the boundary as 0
+			double cn = (i - 1 >= 1) ? rn[j] : 0.0;
+			double cs = (i + 1 <= fine->M - 2) ? rs[j] : 0.0;
+			double ln = (i - 1 >= 1 && j - 1 >= 1) ? rn[j-1] : 0.0;
+			double rn1 = (i - 1 >= 1 && j + 1 <= fine->N - 2) ? rn[j+1] : 0.0;
+			double lc = (j - 1 >= 1) ? rc[j-1] : 0.0;
+			double rc1 = (j + 1 <= fine->N - 2) ? rc[j+1] : 0.0;
+			double ls = (i + 1 <= fine->M - 2 && j - 1 >= 1) ? rs[j-1] : 0.0;
+			double rs1 = (i + 1 <= fine->M - 2 && j + 1 <= fine->N - 2) ? rs[j+1] : 0.0;
+			double north = wj * ln + (1 - 2 * wj) * cn + wj * rn1;
+			double mid = wj * lc + (1 - 2 * wj) * rc[j] + wj * rc1;
+			double south = wj * ls + (1 - 2 * wj) * cs + wj * rs1;
+			f[J] = wi * north + (1 - 2 * wi) * mid + wi * south;
+		}
+	}
+}
+
+/*
+ * u(l) += bilinear interpolation of u(l+1), interior points only.
+ * With add == 0 the interior of u(l) is replaced instead (FMG).
+ */
+static void mgProlong(Multigrid *mg, int l, int rank, int add)
+{
+	MGLevel *fine = &mg->level[l];
+	MGLevel *coarse = &mg->level[l + 1];
+	int first, last, i, j;
+
+	mgRows(fine->M, rank, mg->threads, &first, &last);
+	for (i = first; i <= last; i++)
+	{
+		double *row = GRID_ROW(&fine->u, i);
+		int I = fine->upI[i];
+		double a = fine->upA[i];
+		const double *c0 = GRID_ROW(&coarse->u, I);
+		const double *c1 = GRID_ROW(&coarse->u, (I + 1 < coarse->M) ? I + 1 : I);
+		for (j = 1; j < fine->N - 1; j++)
+		{
+			int J = fine->upJ[j];
+			int J1 = (J + 1 < coarse->N) ? J + 1 : J;
+			double b = fine->upB[j];
+			double v = (1 - a) * ((1 - b) * c0[J] + b * c0[J1]) +
+				a * ((1 - b) * c1[J] + b * c1[J1]);
+			row[j] = add ? row[j] + v : v;
+		}
+	}
+}
+
+/*
+ * One V-cycle on level l
+ */
+static void mgVCycle(Multigrid *mg, int l, int rank, int *sense)
+{
+	if (l == mg->levels - 1)
+	{
+		mgSmooth(mg, l, rank, sense, mg->coarseSweeps);
+		return;
+	}
+	mgSmooth(mg, l, rank, sense, mg->preSmooth);
+	mgResidual(mg, l, rank);
+	barrierWait(&mg->bar, sense);
+	mgRestrict(mg, l, rank);
+	barrierWait(&mg->bar, sense);
+	mgVCycle(mg, l + 1, rank, sense);
+	mgProlong(mg, l, rank, 1);
+	barrierWait(&mg->bar, sense);
+	mgSmooth(mg, l, rank, sense, mg->postSmooth);
+}
+
+/*
+ * Boundary of level l sampled from the plate (linear interpolation along
+ * each edge), interior set to 0, f = 0. Done by rank 0 only.
+ */
+static void mgSampleBoundary(Multigrid *mg, int l)
+{
+	MGLevel *lv = &mg->level[l];
+	Grid *u0 = &mg->level[0].u;
+	int M0 = u0->M, N0 = u0->N;
+	int i, j;
+
+	for (i = 0; i < lv->M; i++)
+		mgClearRow(lv, i);
+	for (j = 0; j < lv->N; j++)
+	{
+		double y = (double) j * (N0 - 1) / (lv->N - 1);
+		int k = (int) floor(y);
+		double b = y - k;
+		int k1 = (k + 1 < N0) ? k + 1 : k;
+		GRID_ROW(&lv->u, 0)[j] = (1 - b) * GRID_ROW(u0, 0)[k] + b * GRID_ROW(u0, 0)[k1];
+		GRID_ROW(&lv->u, lv->M - 1)[j] = (1 - b) * GRID_ROW(u0, M0 - 1)[k] +
+			b * GRID_ROW(u0, M0 - 1)[k1];
+	}
+	for (i = 1; i < lv->M - 1; i++)
+	{
+		double x = (double) i * (M0 - 1) / (lv->M - 1);
+		int k = (int) floor(x);
+		double a = x - k;
+		int k1 = (k + 1 < M0) ? k + 1 : k;
+		GRID_ROW(&lv->u, i)[0] = (1 - a) * GRID_ROW(u0, k)[0] + a * GRID_ROW(u0, k1)[0];
+		GRID_ROW(&lv->u, i)[lv->N - 1] = (1 - a) * GRID_ROW(u0, k)[N0 - 1] +
+			a * GRID_ROW(u0, k1)[N0 - 1];
+	}
+}
+
+/*
+ * Full multigrid start: solve the coarsest version of the plate, then on
+ * every finer level interpolate the coarser solution and run one V-cycle.
+ * Replaces the interior of the plate.
+ */
+static void mgFullStart(Multigrid *mg, int rank, int *sense)
+{
+	int l;
+
+	if (rank == 0)
+		mgSampleBoundary(mg, mg->levels - 1);
+	barrierWait(&mg->bar, sense);
+	mgSmooth(mg, mg->levels - 1, rank, sense, mg->coarseSweeps);
+	for (l = mg->levels - 2; l >= 0; l--)
+	{
+		//Level l + 1 keeps its solution until it has been interpolated
+		if (rank == 0 && l > 0)
+			mgSampleBoundary(mg, l);
+		barrierWait(&mg->bar, sense);
+		mgProlong(mg, l, rank, 0);
+		barrierWait(&mg->bar, sense);
+		mgVCycle(mg, l, rank, sense);
+	}
+}
+
+/* mgSolve
+ *	Called by each of the mg->threads threads with its rank.
+ *	Runs cycles until the largest residual of the plate, divided by the
+ *	stencil's diagonal (4), is below eps. That quantity is exactly how much
+ *	one more Jacobi sweep would change the plate, so eps means the same as
+ *	for the relaxation solvers.
+ *	print - print cycle information (rank 0)
+ *
+ *	returns
+ *	    - number of cycles (FMG start counts as one)
+ *	    - the plate contains the final temperature distribution
+ */
+int mgSolve(Multigrid *mg, int rank, double eps, int print, double *tol)
+{
+	int *sense = &mg->sense[rank];
+	int cycles = 0;
+	double change;
+	Grid *u = &mg->level[0].u;
+
+	if (u->M < 3 || u->N < 3)
+	{
+		*tol = 0.0;
+		return 0;
+	}
+	if (print && rank == 0)
+		printf( "\n Cycle      Change\n" );
+
+	if (mg->cycle == MG_FMG && mg->levels > 1)
+	{
+		mgFullStart(mg, rank, sense);
+		cycles++;
+	}
+	else
+		barrierWait(&mg->bar, sense);
+	change = barrierReduceMax(&mg->bar, sense, mgResidual(mg, 0, rank)) / 4.0;
+	if (print && rank == 0 && cycles > 0)
+		printf ( "  %8d  %f\n", cycles, change );
+
+	while ( eps <= change )
+	{
+		if (mg->levels > 1)
+			mgVCycle(mg, 0, rank, sense);
+		else
+			mgSmooth(mg, 0, rank, sense, mg->coarseSweeps);
+		cycles++;
+		change = barrierReduceMax(&mg->bar, sense, mgResidual(mg, 0, rank)) / 4.0;
+		if (print && rank == 0)
+			printf ( "  %8d  %f\n", cycles, change );
+	}
+	*tol = change;
+	return cycles;
+}
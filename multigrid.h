@@ -0,0 +1,55 @@
+/*
+ *	Geometric multigrid solver for the steady state plate
+ *
+ *	Level 0 is the plate itself; every coarser level has about half as many
+ *	intervals in each direction (a direction that is already small is left
+ *	alone). Levels keep their own row and column spacing, measured in plate
+ *	grid steps, so plates of any size can be coarsened.
+ *
+ *	The smoother is red-black Gauss-Seidel: on the plate it is the existing
+ *	heat2dSweepRB stencil, on coarse levels the same update with a right
+ *	hand side and the level's spacing. Residuals are restricted with full
+ *	weighting and corrections are brought back with bilinear interpolation.
+ *
+ *	All the operations are split over rows between mg->threads threads that
+ *	call mgSolve() together and meet at mg->bar after each step; with one
+ *	thread it is the serial solver.
+ */
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include <pthread.h>
+#include "grid.h"
+#include "barrier.h"
+
+#define MG_VCYCLE 0		//V-cycles from the initial plate
+#define MG_FMG 1		//full multigrid start, then V-cycles
+
+typedef struct {
+	int M, N;
+	double ci, cj;		//1/hi^2 and 1/hj^2 of this level
+	Grid u;				//solution (level 0) or correction (coarser levels)
+	Grid f;				//right hand side, unused on level 0 (always 0)
+	Grid r;				//residual
+	int *upI, *upJ;		//coarse row/column left of each row/column of this level
+	double *upA, *upB;	//bilinear weight of the coarse row/column after it
+	int *downI, *downJ;	//row/column of the finer level under each row/column
+} MGLevel;
+
+typedef struct {
+	int levels;
+	MGLevel *level;
+	int cycle;			//MG_VCYCLE or MG_FMG
+	int preSmooth;		//smoothing sweeps before and after the coarse
+	int postSmooth;		//grid correction
+	int coarseSweeps;	//sweeps that solve the coarsest level
+	int threads;
+	Barrier bar;
+	int *sense;			//local sense of every thread for bar, kept across solves
+} Multigrid;
+
+int mgInit(Multigrid *mg, Grid *u, int threads, int cycle);
+void mgFree(Multigrid *mg);
+int mgSolve(Multigrid *mg, int rank, double eps, int print, double *tol);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ *	Persistent worker pool and work-stealing task queue
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threadpool.h"
+
+typedef struct {
+	ThreadPool *pool;
+	int rank;
+} Worker;
+
+/*
+ * Worker loop: wait for a new generation, run the job, report back
+ */
+static void *poolWorker(void *arg)
+{
+	Worker *self = (Worker *) arg;
+	ThreadPool *pool = self->pool;
+	int rank = self->rank;
+	int seen = 0;
+
+	free(self);
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+	{
+		while (pool->generation == seen && !pool->quit)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		seen = pool->generation;
+		PoolJob job = pool->job;
+		void *jobArg = pool->arg;
+		pthread_mutex_unlock(&pool->lock);
+
+		job(jobArg, rank);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->running == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/*
+ * Start a pool of size workers
+ * Return: the pool, NULL if memory or threads could not be had (the
+ *	workers already started are stopped again)
+ */
+ThreadPool *poolCreate(int size)
+{
+	ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+	int rank;
+
+	if (pool == NULL)
+		return NULL;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->handles = malloc(size * sizeof(pthread_t));
+	if (pool->handles == NULL)
+	{
+		poolDestroy(pool);
+		return NULL;
+	}
+
+	for (rank = 0; rank < size; rank++)
+	{
+		Worker *w = malloc(sizeof(Worker));
+		if (w != NULL)
+		{
+			w->pool = pool;
+			w->rank = rank;
+		}
+		if (w == NULL || pthread_create(&pool->handles[rank], NULL, poolWorker, w) != 0)
+		{
+			free(w);
+			poolDestroy(pool);
+			return NULL;
+		}
+		pool->size = rank + 1;
+	}
+	return pool;
+}
+
+/*
+ * Pin worker rank to CPU cpus[rank], for every worker
+ * Return: 0 on success, -1 if a CPU could not be set
+ */
+int poolPin(ThreadPool *pool, const int *cpus)
+{
+	int rank;
+	int status = 0;
+
+	for (rank = 0; rank < pool->size; rank++)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[rank], &set);
+		if (pthread_setaffinity_np(pool->handles[rank], sizeof(set), &set) != 0)
+			status = -1;
+	}
+	return status;
+}
+
+/*
+ * Run job(arg, rank) on every worker and wait for all of them to return
+ */
+void poolRun(ThreadPool *pool, PoolJob job, void *arg)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->job = job;
+	pool->arg = arg;
+	pool->running = pool->size;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	while (pool->running > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void poolDestroy(ThreadPool *pool)
+{
+	int rank;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (rank = 0; rank < pool->size; rank++)
+		pthread_join(pool->handles[rank], NULL);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->handles);
+	free(pool);
+}
+
+/******************************************************************************/
+/* Task queue */
+/******************************************************************************/
+
+#define PACK(next, end) ((unsigned long long) (unsigned) (next) | \
+		((unsigned long long) (unsigned) (end) << 32))
+#define NEXT(range) ((int) ((range) & 0xffffffffu))
+#define END(range) ((int) ((range) >> 32))
+
+int taskQueueInit(TaskQueue *q, int workers, int count)
+{
+	void *deques;
+
+	q->workers = workers;
+	q->count = count;
+	if (posix_memalign(&deques, TASK_LINE, workers * sizeof(TaskDeque)) != 0)
+		return -1;
+	q->deques = (TaskDeque *) deques;
+	taskQueueReset(q);
+	return 0;
+}
+
+/*
+ * Give every worker its slice of the tasks again. Must not run while any
+ * worker is taking tasks from q.
+ */
+void taskQueueReset(TaskQueue *q)
+{
+	int r;
+	for (r = 0; r < q->workers; r++)
+	{
+		int first = (int) ((long) q->count * r / q->workers);
+		int end = (int) ((long) q->count * (r + 1) / q->workers);
+		__atomic_store_n(&q->deques[r].range, PACK(first, end), __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * Take the front task of deque d
+ * Return: the task, -1 if d is empty
+ */
+static int takeFront(TaskDeque *d)
+{
+	unsigned long long range = __atomic_load_n(&d->range, __ATOMIC_RELAXED);
+	while (NEXT(range) < END(range))
+	{
+		if (__atomic_compare_exchange_n(&d->range, &range,
+					PACK(NEXT(range) + 1, END(range)), 1,
+					__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return NEXT(range);
+	}
+	return -1;
+}
+
+/*
+ * Take the back task of deque d
+ * Return: the task, -1 if d is empty
+ */
+static int takeBack(TaskDeque *d)
+{
+	unsigned long long range = __atomic_load_n(&d->range, __ATOMIC_RELAXED);
+	while (NEXT(range) < END(range))
+	{
+		if (__atomic_compare_exchange_n(&d->range, &range,
+					PACK(NEXT(range), END(range) - 1), 1,
+					__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return END(range) - 1;
+	}
+	return -1;
+}
+
+/*
+ * Next task for worker rank: its own first, then stolen from the others
+ * Return: the task, -1 once every task of the phase has been handed out
+ */
+int taskNext(TaskQueue *q, int rank)
+{
+	int task = takeFront(&q->deques[rank]);
+	int i;
+
+	for (i = 1; task < 0 && i < q->workers; i++)
+		task = takeBack(&q->deques[(rank + i) % q->workers]);
+	return task;
+}
+
+void taskQueueFree(TaskQueue *q)
+{
+	free(q->deques);
+	q->deques = NULL;
+}
@@ -0,0 +1,57 @@
+/*
+ *	Persistent worker pool and work-stealing task queue
+ *
+ *	The pool starts its threads once; between jobs they sleep on a
+ *	condition variable. poolRun() hands every worker the same job, each
+ *	with its own rank, and returns when all of them are done.
+ *
+ *	A TaskQueue hands out the task numbers 0..count-1 of one phase. Every
+ *	worker owns a contiguous slice of them (the same slice every time, so a
+ *	worker keeps touching the same part of the grid) and takes tasks from
+ *	the front of its slice; a worker whose slice is empty steals from the
+ *	back of another one.
+ */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+
+typedef void (*PoolJob)(void *arg, int rank);
+
+typedef struct {
+	int size;				//number of workers
+	pthread_t *handles;
+	pthread_mutex_t lock;
+	pthread_cond_t start;	//signalled when a job is posted
+	pthread_cond_t done;	//signalled when the last worker finishes it
+	PoolJob job;
+	void *arg;
+	int generation;			//incremented for every job
+	int running;			//workers still inside the current job
+	int quit;
+} ThreadPool;
+
+ThreadPool *poolCreate(int size);
+int poolPin(ThreadPool *pool, const int *cpus);
+void poolRun(ThreadPool *pool, PoolJob job, void *arg);
+void poolDestroy(ThreadPool *pool);
+
+#define TASK_LINE 64
+
+typedef struct {
+	unsigned long long range;	//next task (low 32 bits) and end (high 32 bits)
+	char pad[TASK_LINE - sizeof(unsigned long long)];
+} TaskDeque;
+
+typedef struct {
+	int workers;
+	int count;
+	TaskDeque *deques;
+} TaskQueue;
+
+int taskQueueInit(TaskQueue *q, int workers, int count);
+void taskQueueReset(TaskQueue *q);
+int taskNext(TaskQueue *q, int rank);
+void taskQueueFree(TaskQueue *q);
+
+#endif